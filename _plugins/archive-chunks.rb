@@ -0,0 +1,87 @@
+#!/usr/bin/env ruby
+#
+# Split the archives tab into per-year chunks
+#
+# The theme's archives layout lists every post in one page. This writes
+# `<path>/index.json` with the years and their post counts, and one
+# `<path>/<year>.json` per year, which the archives layout fetches as the
+# year groups scroll into view (see `assets/js/archives.js`). Readers
+# without JavaScript get `per_page` posts on the tab itself and further
+# static pages at `<tab>/page/<n>/`, through `page.archive_pager`.
+
+require 'json'
+
+module Jekyll
+  module ArchiveChunks
+    DEFAULTS = {
+      'enabled'  => true,
+      'path'     => 'assets/js/data/archives',
+      'per_page' => 50
+    }.freeze
+
+    class Generator < Jekyll::Generator
+      safe true
+      priority :low
+
+      def generate(site)
+        config = DEFAULTS.merge(site.config['archives_tab'] || {})
+        return unless config['enabled']
+
+        tab = site.collections['tabs']&.docs&.find { |doc| doc.data['layout'] == 'archives' }
+        return if tab.nil?
+
+        posts = site.posts.docs.reject { |post| post.data['published'] == false }.sort_by { |post| -post.date.to_i }
+        format = site.data.dig('locales', site.config['lang'], 'df', 'archives', 'strftime') || '/ %m'
+
+        years = posts.group_by { |post| post.date.year }
+        years.each do |year, group|
+          entries = group.map do |post|
+            { 'u' => post.url, 't' => post.data['title'], 'd' => post.date.strftime('%d'), 'm' => post.date.strftime(format) }
+          end
+          site.pages << chunk(site, config['path'], "#{ year }.json", 'year' => year, 'posts' => entries)
+        end
+        years = years.map { |year, group| { 'year' => year, 'count' => group.size } }
+        site.pages << chunk(site, config['path'], 'index.json', 'years' => years)
+
+        paginate(site, tab, posts, config['per_page'].to_i)
+      end
+
+      private
+
+      def chunk(site, dir, name, data)
+        page = PageWithoutAFile.new(site, site.source, dir, name)
+        page.content = JSON.generate(data)
+        page.data['render_with_liquid'] = false
+        page.data['sitemap'] = false
+        page
+      end
+
+      def paginate(site, tab, posts, per_page)
+        slices = posts.each_slice([per_page, 1].max).to_a
+        url = ->(n) { n == 1 ? tab.url : "#{ tab.url }page/#{ n }/" }
+
+        slices.each.with_index(1) do |slice, n|
+          pager = {
+            'posts'        => slice,
+            'page'         => n,
+            'total_pages'  => slices.size,
+            'previous_url' => n > 1 ? url.call(n - 1) : nil,
+            'next_url'     => n < slices.size ? url.call(n + 1) : nil
+          }
+
+          if n == 1
+            tab.data['archive_pager'] = pager
+            next
+          end
+
+          page = PageWithoutAFile.new(site, site.source, url.call(n), 'index.html')
+          page.content = ''
+          page.data.merge!(tab.data.slice('title', 'icon'))
+          page.data['layout'] = 'archives'
+          page.data['archive_pager'] = pager
+          site.pages << page
+        end
+      end
+    end
+  end
+end
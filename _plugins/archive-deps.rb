@@ -0,0 +1,126 @@
+#!/usr/bin/env ruby
+#
+# Track which posts tag, category and pagination pages depend on
+#
+# Pages generated by jekyll-archives, jekyll-paginate and the archives tab
+# (`archive-chunks.rb`) have no source file, so `--incremental`
+# regenerates all of them on every build. This
+# keeps a post -> page graph in `.jekyll-cache/archive-deps.json`: each
+# such page records the posts it lists and their signatures, and is only
+# regenerated when that list or one of those posts changed, or when the
+# layouts, includes or config did. Adding a post therefore only touches
+# its tag and category pages and the pagination pages it shifts.
+
+require 'digest'
+require 'json'
+
+module Jekyll
+  module ArchiveDeps
+    class << self
+      def prepare(site)
+        @decisions = {}
+        @groups = {}
+        return unless site.incremental?
+
+        @file = site.in_cache_dir('archive-deps.json')
+        previous = load
+        global = global_signature(site)
+        stale = previous['global'] != global
+        signatures = {}
+
+        site.pages.each do |page|
+          members = members(page)
+          next if members.nil?
+
+          full = paginated?(page)
+          list = members.map do |post|
+            key = [post.relative_path, full]
+            signatures[key] ||= signature(post, full)
+            [post.relative_path, signatures[key]]
+          end
+
+          id = page.url
+          @groups[id] = list
+          @decisions[id] = stale || previous.dig('groups', id) != list
+        end
+
+        @state = { 'global' => global, 'groups' => @groups }
+      end
+
+      def tracked?(page)
+        @decisions&.key?(page.url) && members(page)
+      end
+
+      def regenerate?(page)
+        @decisions[page.url]
+      end
+
+      # The posts a generated listing page shows, or nil for other pages.
+      def members(page)
+        if defined?(Jekyll::Archives::Archive) && page.is_a?(Jekyll::Archives::Archive)
+          page.posts
+        elsif paginated?(page)
+          page.pager.posts
+        elsif page.data['archive_pager']
+          page.data['archive_pager']['posts']
+        end
+      end
+
+      def paginated?(page)
+        page.respond_to?(:pager) && page.pager.respond_to?(:posts)
+      end
+
+      def save
+        return if @state.nil? || @file.nil?
+
+        FileUtils.mkdir_p(File.dirname(@file))
+        File.write(@file, JSON.generate(@state))
+      end
+
+      private
+
+      def load
+        File.file?(@file) ? JSON.parse(File.read(@file)) : {}
+      rescue JSON::ParserError
+        {}
+      end
+
+      # Tag and category pages show titles and dates; paginated home pages
+      # also show an excerpt of the content.
+      def signature(post, full)
+        data = post.data.slice('title', 'date', 'categories', 'tags', 'pin', 'image', 'description', 'last_modified_at')
+        parts = [post.url, data.to_a.inspect]
+        parts << post.content if full
+        Digest::SHA256.hexdigest(parts.join("\0"))[0, 16]
+      end
+
+      def global_signature(site)
+        files = site.layouts.values.map(&:path)
+        files += site.includes_load_paths.flat_map { |dir| Dir.glob(File.join(dir, '**', '*')) }
+        stamps = files.select { |f| File.file?(f) }.sort.map { |f| "#{ f }:#{ File.mtime(f).to_i }" }
+        Digest::SHA256.hexdigest([site.config.inspect, *stamps].join("\n"))
+      end
+    end
+
+    module Regenerator
+      # Pagination pages still have `index.html` as their source, so its own
+      # changes are picked up by the default check.
+      def regenerate_page?(page)
+        return super unless ArchiveDeps.tracked?(page)
+
+        ArchiveDeps.regenerate?(page) || !File.exist?(page.destination(site.dest)) ||
+          (ArchiveDeps.paginated?(page) && super)
+      end
+    end
+
+    Jekyll::Regenerator.prepend Regenerator
+  end
+end
+
+Jekyll::Hooks.register :site, :pre_render do |site|
+  Jekyll::ArchiveDeps.prepare(site)
+end
+
+Jekyll::Hooks.register :site, :post_write do |_site|
+  Jekyll::ArchiveDeps.save
+end
@@ -0,0 +1,140 @@
+#!/usr/bin/env ruby
+#
+# Give output assets content-addressed names
+#
+# After the site is written, every file under `asset_hash.dirs` is renamed
+# to `<name>.<hash>.<ext>` and the references to it in the HTML, CSS, XML
+# and web manifests of the output are rewritten. Byte-identical files end
+# up as one file. Since a name now changes with the content, the host can
+# serve these files as immutable; the rules for that are written to
+# `asset_hash.headers` (Netlify / Cloudflare Pages `_headers`, one rule
+# per directory since Cloudflare reads at most 100) and to an nginx
+# snippet next to the destination. Names that already carry a content
+# hash, such as the responsive image variants, are kept.
+#
+# The hook runs after the `:high` post-write steps, which still reference
+# the original names, and before the service worker manifest and the
+# precompressed siblings, which have to see the final names.
+
+require 'digest'
+
+module Jekyll
+  module AssetHash
+    DEFAULTS = {
+      'envs'       => %w(production),
+      'dirs'       => %w(assets/img),
+      'extensions' => %w(png jpg jpeg gif webp avif svg ico),
+      'exclude'    => [],
+      'rewrite'    => %w(html css xml json webmanifest),
+      'length'     => 12,
+      'headers'    => '_headers',
+      'nginx'      => 'asset-headers.nginx.conf'
+    }.freeze
+
+    CACHE_CONTROL = 'public, max-age=31536000, immutable'
+    REVALIDATE = 'public, max-age=0, must-revalidate'
+    CSS_URL = /url\(\s*(['"]?)([^'")]+)\1\s*\)/.freeze
+
+    class << self
+      def config(site)
+        DEFAULTS.merge(site.config['asset_hash'] || {})
+      end
+
+      def enabled?(site)
+        config(site)['envs'].include?(Jekyll.env)
+      end
+
+      def run(site)
+        config = config(site)
+        mapping = rename(site, config)
+        return if mapping.empty?
+
+        rewrite(site, config, mapping)
+        headers(site, config)
+        Jekyll.logger.info 'Asset hash:', "#{ mapping.size } file(s) renamed, #{ mapping.size - mapping.values.uniq.size } duplicate(s) removed"
+      end
+
+      private
+
+      # Returns `old url => new url`; duplicates map to the first file, in
+      # path order, with the same content. A name with a hex segment of 8 or
+      # more digits before the extension is already content-addressed.
+      def rename(site, config)
+        pattern = "{#{ config['dirs'].join(',') }}/**/*.{#{ config['extensions'].join(',') }}"
+        hashed = /\.\h{8,}\.[^.]+\z/
+        canonical = {}
+        mapping = {}
+
+        Dir.glob(pattern, base: site.dest).sort.each do |rel|
+          file = File.join(site.dest, rel)
+          next unless File.file?(file) && !rel.match?(hashed) && !config['exclude'].include?(rel)
+
+          digest = Digest::SHA256.file(file).hexdigest
+          ext = File.extname(rel)
+          target = canonical[digest] ||= rel.delete_suffix(ext) + ".#{ digest[0, config['length']] }#{ ext }"
+
+          if File.file?(File.join(site.dest, target))
+            File.delete(file)
+          else
+            File.rename(file, File.join(site.dest, target))
+          end
+          mapping["#{ site.baseurl }/#{ rel }"] = "#{ site.baseurl }/#{ target }"
+        end
+
+        mapping
+      end
+
+      def rewrite(site, config, mapping)
+        urls = Regexp.union(mapping.keys.sort_by { |url| -url.size })
+        absolute = /#{ urls }(?=[\s"'()?#,\\<]|\z)/
+
+        Dir.glob("**/*.{#{ config['rewrite'].join(',') }}", base: site.dest).each do |rel|
+          file = File.join(site.dest, rel)
+          next unless File.file?(file)
+
+          text = File.read(file)
+          updated = text.gsub(absolute) { |url| mapping[url] }
+          updated = relative_css(updated, "#{ site.baseurl }/#{ rel }", mapping) if rel.end_with?('.css')
+          File.write(file, updated) unless updated == text
+        end
+      end
+
+      # Stylesheets may refer to images relative to themselves.
+      def relative_css(css, url, mapping)
+        css.gsub(CSS_URL) do |match|
+          quote, ref = Regexp.last_match(1), Regexp.last_match(2)
+          next match if ref.start_with?('/', 'data:', 'http:', 'https:', '#')
+
+          path, suffix = ref.split(/(?=[?#])/, 2)
+          resolved = File.expand_path(path, File.dirname(url))
+          mapping.key?(resolved) ? "url(#{ quote }#{ mapping[resolved] }#{ suffix }#{ quote })" : match
+        end
+      end
+
+      # Everything under `dirs` but `exclude` has a hashed name, so a splat
+      # rule per directory covers it and only the exclusions are listed,
+      # detached (`!`) from the matching splat rule.
+      def headers(site, config)
+        if config['headers']
+          rules = config['dirs'].map { |dir| "#{ site.baseurl }/#{ dir.chomp('/') }/*\n  Cache-Control: #{ CACHE_CONTROL }\n" }
+          rules += config['exclude'].map { |rel| "#{ site.baseurl }/#{ rel }\n  ! Cache-Control\n  Cache-Control: #{ REVALIDATE }\n" }
+          File.write(File.join(site.dest, config['headers']), rules.join)
+        end
+        return unless config['nginx']
+
+        extensions = config['extensions'].join('|')
+        File.write(File.expand_path("../#{ config['nginx'] }", site.dest), <<~NGINX)
+          # Content-hashed assets, see _plugins/asset-hash.rb
+          location ~* "\\.[0-9a-f]{8,}\\.(#{ extensions })$" {
+              add_header Cache-Control "#{ CACHE_CONTROL }";
+          }
+        NGINX
+      end
+    end
+  end
+end
+
+# Between the `:high` (30) and the `:normal` (20) post-write hooks.
+Jekyll::Hooks.register :site, :post_write, priority: 25 do |site|
+  Jekyll::AssetHash.run(site) if Jekyll::AssetHash.enabled?(site)
+end
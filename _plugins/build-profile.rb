@@ -0,0 +1,179 @@
+#!/usr/bin/env ruby
+#
+# Profile the build per phase, hook, generator, converter and page
+#
+# Enabled with `build_profile.enabled` or `JEKYLL_BUILD_PROFILE=1`. Every
+# registered hook, generator and converter, each layout render and the
+# Rouge and jekyll-scholar entry points are wrapped with a monotonic timer
+# and an allocation counter. After the site is processed, the events are
+# written next to the destination, in `build-profile/trace.json` (Chrome
+# trace-event format, open it in chrome://tracing or Perfetto) and
+# `build-profile/pages.csv` (one row per rendered page).
+
+require 'csv'
+require 'json'
+
+module Jekyll
+  module BuildProfile
+    Event = Struct.new(:name, :cat, :start, :duration, :allocations, :page)
+
+    class << self
+      attr_reader :events
+
+      def enabled?(site)
+        ENV['JEKYLL_BUILD_PROFILE'] == '1' || site.config.dig('build_profile', 'enabled') == true
+      end
+
+      def now
+        Process.clock_gettime(Process::CLOCK_MONOTONIC, :microsecond)
+      end
+
+      def reset
+        @events = []
+        @origin = now
+        @page = nil
+      end
+
+      def measure(name, cat, page = @page)
+        return yield if @events.nil?
+
+        allocated = GC.stat(:total_allocated_objects)
+        start = now
+        begin
+          yield
+        ensure
+          @events << Event.new(name, cat, start - @origin, now - start,
+                               GC.stat(:total_allocated_objects) - allocated, page)
+        end
+      end
+
+      def page(path)
+        previous = @page
+        @page = path
+        yield
+      ensure
+        @page = previous
+      end
+
+      def instrument(site)
+        return if @instrumented
+
+        @instrumented = true
+        wrap_hooks
+        site.generators.each { |g| g.singleton_class.prepend(GeneratorTimer) }
+        site.converters.each { |c| c.singleton_class.prepend(ConverterTimer) }
+        Jekyll::Site.prepend(SiteTimer)
+        Jekyll::Renderer.prepend(RendererTimer)
+
+        if defined?(Kramdown::Converter::SyntaxHighlighter::Rouge)
+          Kramdown::Converter::SyntaxHighlighter::Rouge.singleton_class.prepend(RougeTimer)
+        end
+        Jekyll::Scholar::Utilities.prepend(ScholarTimer) if defined?(Jekyll::Scholar::Utilities)
+      end
+
+      def write(site)
+        return if @events.nil? || @events.empty?
+
+        dir = File.expand_path('../build-profile', site.dest)
+        FileUtils.mkdir_p(dir)
+
+        trace = @events.map do |e|
+          { 'name' => e.name, 'cat' => e.cat, 'ph' => 'X', 'ts' => e.start, 'dur' => e.duration,
+            'pid' => Process.pid, 'tid' => 1, 'args' => { 'allocations' => e.allocations, 'page' => e.page }.compact }
+        end
+        File.write(File.join(dir, 'trace.json'), JSON.generate('traceEvents' => trace, 'displayTimeUnit' => 'ms'))
+
+        CSV.open(File.join(dir, 'pages.csv'), 'w') do |csv|
+          csv << %w(page render_ms converter_ms layout_ms hook_ms allocations)
+          @events.select(&:page).group_by(&:page).each do |page, events|
+            total = ->(cat) { (events.select { |e| e.cat == cat }.sum(&:duration) / 1000.0).round(2) }
+            render = events.find { |e| e.cat == 'render' }
+            csv << [page, total.call('render'), total.call('converter'), total.call('layout'),
+                    total.call('hook'), render&.allocations]
+          end
+        end
+
+        Jekyll.logger.info 'Build profile:', "Written to #{ dir }"
+      end
+
+      private
+
+      # Hooks are plain procs in Jekyll::Hooks' registry; each is replaced by
+      # a timed proc, keeping its priority.
+      def wrap_hooks
+        registry = Jekyll::Hooks.instance_variable_get(:@registry)
+        priorities = Jekyll::Hooks.instance_variable_get(:@hook_priority)
+
+        registry.each do |owner, events|
+          events.each do |event, hooks|
+            hooks.map! do |hook|
+              file, line = hook.source_location
+              name = "#{ owner }:#{ event } #{ File.basename(file.to_s) }:#{ line }"
+              timed = proc do |*args|
+                target = args.first.respond_to?(:relative_path) ? args.first.relative_path : nil
+                BuildProfile.measure(name, 'hook', target) { hook.call(*args) }
+              end
+              priorities[timed] = priorities[hook] if priorities
+              timed
+            end
+          end
+        end
+      end
+    end
+
+    module SiteTimer
+      def process
+        BuildProfile.reset if BuildProfile.enabled?(self)
+        BuildProfile.measure('process', 'phase') { super }
+        BuildProfile.write(self)
+      end
+
+      %i(reset read generate render cleanup write).each do |phase|
+        define_method(phase) { BuildProfile.measure(phase.to_s, 'phase') { super() } }
+      end
+    end
+
+    module GeneratorTimer
+      def generate(site)
+        BuildProfile.measure(self.class.name, 'generator') { super }
+      end
+    end
+
+    module ConverterTimer
+      def convert(content)
+        BuildProfile.measure(self.class.name, 'converter') { super }
+      end
+    end
+
+    module RendererTimer
+      def run
+        path = document.respond_to?(:relative_path) ? document.relative_path : document.to_s
+        BuildProfile.page(path) { BuildProfile.measure(path, 'render') { super } }
+      end
+
+      def render_layout(output, layout, info)
+        BuildProfile.measure("layout #{ layout.name }", 'layout') { super }
+      end
+    end
+
+    module RougeTimer
+      def call(converter, text, lang, type, call_opts)
+        BuildProfile.measure("rouge #{ lang }", 'rouge') { super }
+      end
+    end
+
+    module ScholarTimer
+      def render_citation(items)
+        BuildProfile.measure('scholar citation', 'scholar') { super }
+      end
+
+      def render_bibliography(entry, index = nil)
+        BuildProfile.measure('scholar bibliography', 'scholar') { super }
+      end
+    end
+  end
+end
+
+Jekyll::Hooks.register :site, :after_init do |site|
+  Jekyll::BuildProfile.instrument(site) if Jekyll::BuildProfile.enabled?(site)
+end
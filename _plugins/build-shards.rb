@@ -0,0 +1,107 @@
+#!/usr/bin/env ruby
+#
+# Split rendering of the posts across several builds
+#
+# With `JEKYLL_SHARD=<index>/<count>` the build reads and generates the
+# whole site as usual but renders only the posts whose path hashes to
+# `index`, and instead of writing the site it writes their rendered
+# content and output to `$JEKYLL_SHARD_OUT/shard-<index>.json` (default
+# `_shards`). Generators such as the C++ snippets only do work for those
+# posts too.
+#
+# With `JEKYLL_SHARD_MERGE=<dir>` the build loads every shard manifest in
+# `dir` before rendering, renders the pages and everything else but the
+# posts from it, and writes the whole site, running the site-wide steps
+# (archives, pagination, feed, search index, ...) once.
+
+require 'json'
+require 'zlib'
+
+module Jekyll
+  module BuildShards
+    class MissingShard < StandardError; end
+
+    class << self
+      def shard
+        return @shard if defined?(@shard)
+
+        @shard = ENV['JEKYLL_SHARD'].to_s.match(%r{\A(\d+)/(\d+)\z})&.captures&.map(&:to_i)
+      end
+
+      def merge_dir
+        ENV['JEKYLL_SHARD_MERGE'].to_s.empty? ? nil : ENV['JEKYLL_SHARD_MERGE']
+      end
+
+      def post?(doc)
+        doc.respond_to?(:collection) && doc.collection&.label == 'posts'
+      end
+
+      # Whether this build renders `doc`.
+      def render?(doc)
+        if shard
+          post?(doc) && Zlib.crc32(doc.relative_path) % shard[1] == shard[0]
+        elsif merge_dir
+          !post?(doc)
+        else
+          true
+        end
+      end
+
+      def write_manifest(site)
+        entries = site.posts.docs.select { |post| render?(post) && post.output }.map do |post|
+          excerpt = post.data['excerpt']
+          excerpt = nil unless excerpt.respond_to?(:output)
+          { 'path' => post.relative_path, 'content' => post.content, 'output' => post.output,
+            'excerpt_content' => excerpt&.content, 'excerpt_output' => excerpt&.output }
+        end
+
+        dir = File.expand_path(ENV['JEKYLL_SHARD_OUT'] || '_shards', site.source)
+        FileUtils.mkdir_p(dir)
+        File.write(File.join(dir, "shard-#{ shard[0] }.json"), JSON.generate(entries))
+        Jekyll.logger.info 'Shards:', "Rendered #{ entries.size } of #{ site.posts.docs.size } post(s) as shard #{ shard.join('/') }"
+      end
+
+      def load_manifests(site)
+        entries = Dir.glob(File.join(merge_dir, 'shard-*.json')).flat_map { |file| JSON.parse(File.read(file)) }
+        entries = entries.to_h { |entry| [entry['path'], entry] }
+
+        site.posts.docs.each do |post|
+          entry = entries[post.relative_path]
+          raise MissingShard, "No shard rendered #{ post.relative_path }" if entry.nil?
+
+          post.content = entry['content']
+          post.output = entry['output']
+
+          excerpt = post.data['excerpt']
+          next unless excerpt.respond_to?(:output=)
+
+          excerpt.content = entry['excerpt_content'] unless entry['excerpt_content'].nil?
+          excerpt.output = entry['excerpt_output'] unless entry['excerpt_output'].nil?
+        end
+        Jekyll.logger.info 'Shards:', "Merged #{ entries.size } rendered post(s) from #{ merge_dir }"
+      end
+    end
+
+    module Site
+      def cleanup
+        super unless BuildShards.shard
+      end
+
+      def write
+        BuildShards.shard ? BuildShards.write_manifest(self) : super
+      end
+
+      private
+
+      def render_regenerated(document, payload)
+        super if BuildShards.render?(document)
+      end
+    end
+
+    Jekyll::Site.prepend Site
+  end
+end
+
+Jekyll::Hooks.register :site, :pre_render, priority: :high do |site|
+  Jekyll::BuildShards.load_manifests(site) if Jekyll::BuildShards.merge_dir
+end
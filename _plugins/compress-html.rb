@@ -0,0 +1,133 @@
+#!/usr/bin/env ruby
+#
+# Minify HTML in Ruby instead of the `compress` Liquid layout
+#
+# Implements the `compress_html` options (`clippings`, `comments`,
+# `endings`, `blanklines`, `ignore.envs`) with a single pass of a
+# tokenizer over the rendered page. `_layouts/compress.html` is reduced to
+# `{{ content }}` so the theme's Liquid implementation no longer runs.
+# Unlike the layout, the content of `<script>`, `<style>` and
+# `<textarea>` is kept as is, like `<pre>`. `comments` is `all` or a
+# `[start, end]` marker pair; `profile` is not supported and ignored with
+# a warning.
+#
+# As with the layout, `endings` drops `</head>` among others, so plugins
+# running later must not look for it.
+
+require 'strscan'
+
+module Jekyll
+  module CompressHtml
+    CLIPPINGS = %w(
+      html head title base link meta style body article section nav aside h1 h2 h3 h4 h5 h6 hgroup
+      header footer address p hr blockquote ol ul li dl dt dd figure figcaption main div table
+      caption colgroup col tbody thead tfoot tr td th
+    ).freeze
+
+    ENDINGS = %w(html head body li dt dd optgroup option colgroup caption thead tbody tfoot tr td th).freeze
+
+    RAW = /<(pre|textarea|script|style)\b[^>]*>.*?<\/\1\s*>/im.freeze
+    COMMENT = /<!--.*?-->/m.freeze
+    TAG = /<\/?([a-zA-Z][a-zA-Z0-9-]*)\b(?:[^>"']|"[^"]*"|'[^']*')*>/.freeze
+    TEXT = /[^<]+|</.freeze
+
+    class Compressor
+      def initialize(options)
+        @clippings = list(options['clippings'], CLIPPINGS)
+        @endings = list(options['endings'], ENDINGS)
+        @comments, @markers = comments(options['comments'])
+        @blanklines = options['blanklines'] == true
+        Jekyll.logger.warn 'Compress HTML:', '`profile` is not supported, ignoring it' if options['profile']
+      end
+
+      def compress(html)
+        # Like the layout, everything between custom markers goes, wherever it is.
+        html = html.gsub(@markers, '') if @markers
+        scanner = StringScanner.new(html)
+        out = +''
+        clip = false
+
+        until scanner.eos?
+          if (raw = scanner.scan(RAW))
+            name = scanner[1].downcase
+            out.rstrip! if @clippings.include?(name)
+            out << raw
+            clip = @clippings.include?(name)
+          elsif (comment = scanner.scan(COMMENT))
+            out << comment unless @comments
+          elsif (tag = scanner.scan(TAG))
+            name = scanner[1].downcase
+            closing = tag.start_with?('</')
+            if @clippings.include?(name)
+              out.rstrip!
+              clip = true
+            else
+              clip = false
+            end
+            out << tag unless closing && @endings.include?(name)
+          else
+            text = whitespace(scanner.scan(TEXT))
+            text = text.lstrip if clip
+            clip = false unless text.empty?
+            out << text
+          end
+        end
+
+        out.strip
+      end
+
+      private
+
+      # Returns whether to drop `<!-- -->` comments and the pattern for a
+      # custom marker pair.
+      def comments(option)
+        case option
+        when 'all', %w(<!-- -->) then [true, nil]
+        when nil, [], '', false then [false, nil]
+        else
+          if option.is_a?(Array) && option.size == 2 && option.all? { |m| m.is_a?(String) && !m.empty? }
+            [false, /#{ Regexp.escape(option[0]) }.*?#{ Regexp.escape(option[1]) }/m]
+          else
+            Jekyll.logger.warn 'Compress HTML:', "`comments` must be 'all' or a [start, end] pair, keeping comments (#{ option.inspect })"
+            [false, nil]
+          end
+        end
+      end
+
+      def list(option, all)
+        case option
+        when 'all' then all
+        when Array then option.map(&:to_s)
+        else []
+        end
+      end
+
+      def whitespace(text)
+        @blanklines ? text.gsub(/\n\s*\n/, "\n") : text.gsub(/\s+/, ' ')
+      end
+    end
+
+    class << self
+      def compressor(site)
+        @compressors ||= {}
+        @compressors[site.config['compress_html']] ||= Compressor.new(site.config['compress_html'] || {})
+      end
+
+      def ignored?(site)
+        envs = site.config.dig('compress_html', 'ignore', 'envs')
+        envs == 'all' || Array(envs).map(&:to_s).include?(Jekyll.env)
+      end
+
+      def compress(doc)
+        site = doc.site
+        return if site.config['compress_html'].nil? || ignored?(site)
+
+        doc.output = compressor(site).compress(doc.output)
+      end
+    end
+  end
+end
+
+Jekyll::Hooks.register [:pages, :documents], :post_render, priority: :low do |doc|
+  Jekyll::CompressHtml.compress(doc) if doc.output_ext == '.html' && doc.output
+end
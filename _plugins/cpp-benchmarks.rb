@@ -0,0 +1,192 @@
+#!/usr/bin/env ruby
+#
+# Run Google Benchmark blocks in posts
+#
+# A fenced block followed by an IAL with a `bench` attribute holds one or
+# more `BENCHMARK()` definitions. It is wrapped in a `BENCHMARK_MAIN()`,
+# built once per optimization level and run with a fixed number of
+# repetitions, and a results table is inserted after the block:
+#
+#     ```cpp
+#     static void BM_copy(benchmark::State& state) { ... }
+#     BENCHMARK(BM_copy);
+#     ```
+#     {: bench="c++23" }
+#
+# The raw Google Benchmark JSON is stored in `benchmarks.data_dir` (in the
+# cache dir, so `jekyll serve` does not rebuild on it), one directory per
+# block named after the digest of the source and flags, one file per
+# compiler, and reused by later builds. When the block was also run with
+# another compiler, the table compares against the latest such run.
+# Builds run in parallel, benchmarks themselves one at a time.
+
+require 'time'
+require_relative 'cpp-snippets'
+
+module Jekyll
+  module Benchmarks
+    DEFAULTS = {
+      'enabled'     => true,
+      'compiler'    => nil,
+      'levels'      => %w(-O2 -O3),
+      'flags'       => %w(-DNDEBUG),
+      'libs'        => %w(-lbenchmark -lpthread),
+      'repetitions' => 10,
+      'cpu'         => 0,
+      'data_dir'    => '.jekyll-cache/benchmarks'
+    }.freeze
+
+    # Google Benchmark `time_unit`s in nanoseconds.
+    UNITS = { 'ns' => 1, 'us' => 1e3, 'ms' => 1e6, 's' => 1e9 }.freeze
+
+    class << self
+      def config(site)
+        config = DEFAULTS.merge(site.config['benchmarks'] || {})
+        config['compiler'] ||= Snippets.config(site)['compiler']
+        config
+      end
+
+      def harness(code)
+        "#include <benchmark/benchmark.h>\n#{ code }\nBENCHMARK_MAIN();\n"
+      end
+
+      def run(config, code, std)
+        Dir.mktmpdir('benchmark') do |dir|
+          binaries = {}
+
+          Snippets.parallel(config['levels'], config['levels'].size) do |level|
+            build = File.join(dir, level.delete('-'))
+            FileUtils.mkdir_p(build)
+            flags = ["-std=#{ std }", level, *config['flags']]
+            binaries[level] = Snippets.compile(harness(code), build, config['compiler'], flags, config['libs'])
+          end
+
+          pin = config['cpu'].nil? ? [] : ['taskset', '-c', config['cpu'].to_s]
+          config['levels'].to_h do |level|
+            stdout, stderr, status = Open3.capture3(
+              *pin, binaries[level], '--benchmark_format=json',
+              "--benchmark_repetitions=#{ config['repetitions'] }",
+              '--benchmark_report_aggregates_only=true'
+            )
+            raise Snippets::CompileError, stderr unless status.success?
+
+            [level, JSON.parse(stdout)]
+          end
+        end
+      end
+    end
+
+    class Generator < Jekyll::Generator
+      safe true
+      priority :normal
+
+      def generate(site, posts = site.posts.docs.select { |post| BuildShards.render?(post) })
+        config = Benchmarks.config(site)
+        return unless config['enabled']
+
+        data_dir = site.in_source_dir(config['data_dir'])
+        compiler = Snippets.compiler_id(config['compiler'])
+
+        posts.each do |post|
+          post.content = post.content.gsub(Snippets::BLOCK) do |block|
+            match = Regexp.last_match
+            std = Snippets.attributes(match[:ial])['bench']
+            next block unless std
+
+            key = Snippets.digest(match[:code], std, config.values_at('levels', 'flags', 'repetitions'))
+            dir = File.join(data_dir, key[0, 16])
+            file = File.join(dir, "#{ Snippets.digest(compiler)[0, 16] }.json")
+            data = load(file) || measure(config, match[:code], std, file, compiler, post)
+            warn_failed(post, data['error']) if data&.key?('error')
+            data && !data['error'] ? block + render(data, previous(dir, file)) : block
+          end
+        end
+      end
+
+      private
+
+      def load(file)
+        JSON.parse(File.read(file)) if File.file?(file)
+      rescue JSON::ParserError
+        nil
+      end
+
+      # The latest run of the same block with another compiler.
+      def previous(dir, file)
+        runs = (Dir.glob(File.join(dir, '*.json')) - [file]).filter_map { |other| load(other) }.reject { |run| run['error'] }
+        runs.max_by { |run| run['date'].to_s }
+      end
+
+      # A block that does not build or run is stored with its `error`, so it
+      # is only tried again once the code, flags or compiler change. Missing
+      # tools (SystemCallError) are not stored.
+      def measure(config, code, std, file, compiler, post)
+        Jekyll.logger.info 'Benchmarks:', "Running a benchmark in #{ post.relative_path }"
+        data = { 'compiler' => compiler, 'std' => std, 'date' => Time.now.utc.iso8601 }
+        begin
+          data['runs'] = Benchmarks.run(config, code, std)
+        rescue Snippets::CompileError => e
+          data['error'] = e.message
+        end
+
+        FileUtils.mkdir_p(File.dirname(file))
+        File.write(file, JSON.pretty_generate(data))
+        data
+      rescue SystemCallError => e
+        warn_failed(post, e.message)
+        nil
+      end
+
+      def warn_failed(post, message)
+        Jekyll.logger.warn 'Benchmarks:', "A benchmark in #{ post.relative_path } failed:\n#{ message }"
+      end
+
+      # `name => level => [time, unit, nanoseconds]` of the mean times.
+      def rows(data)
+        rows = Hash.new { |h, k| h[k] = {} }
+
+        data['runs'].each do |level, run|
+          run['benchmarks'].each do |b|
+            next unless b['aggregate_name'].nil? || b['aggregate_name'] == 'mean'
+
+            unit = b['time_unit'] || 'ns'
+            rows[b['run_name'] || b['name']][level] = [b['real_time'], unit, b['real_time'].to_f * UNITS.fetch(unit, 1)]
+          end
+        end
+        rows
+      end
+
+      # One row per benchmark, one column per optimization level, with the
+      # mean time, its ratio to the first benchmark of the block and, when
+      # there is an earlier run with another compiler, the change since.
+      def render(data, previous = nil)
+        levels = data['runs'].keys
+        rows = rows(data)
+        before = previous ? rows(previous) : {}
+
+        baseline = rows.values.first
+        table = ["| Benchmark | #{ levels.join(' | ') } |", "|:--|#{ '--:|' * levels.size }"]
+        rows.each do |name, times|
+          cells = levels.map do |level|
+            time, unit, ns = times[level]
+            next '' if time.nil?
+
+            ratio = baseline[level] ? ns / baseline[level].last : nil
+            old = before.dig(name, level)&.last
+            change = old&.positive? ? format(', %+.0f%%', (ns / old - 1) * 100) : ''
+            "#{ time.round(2) } #{ unit }#{ ratio ? " (#{ ratio.round(2) }×#{ change })" : '' }"
+          end
+          table << "| `#{ name }` | #{ cells.join(' | ') } |"
+        end
+
+        context = data['runs'].values.first['context'] || {}
+        reps = data['runs'].values.first['benchmarks'].first&.dig('repetitions')
+        meta = "*#{ data['compiler'] }, -std=#{ data['std'] }, #{ reps || '?' } repetitions, " \
+               "#{ context['num_cpus'] } CPUs @ #{ context['mhz_per_cpu'] } MHz*"
+        meta += " *Changes are against #{ previous['compiler'] } on #{ previous['date'].to_s[0, 10] }.*" if previous
+
+        "\n\n#{ table.join("\n") }\n{: .benchmark-results }\n\n#{ meta }\n{: .benchmark-meta }\n"
+      end
+    end
+  end
+end
@@ -0,0 +1,190 @@
+#!/usr/bin/env ruby
+#
+# Compile and run C++ snippets in posts
+#
+# A fenced block followed by an IAL with a `run` attribute is compiled
+# with the configured compiler and executed, and its output is inserted
+# into the post right after the block:
+#
+#     ```cpp
+#     int main() { std::println("{}", 42); }
+#     ```
+#     {: run="c++23" flags="-O2" }
+#
+# Results are kept in a Jekyll::Cache keyed by the digest of the source,
+# the flags and the compiler's version string, so unchanged snippets are
+# never compiled twice. New snippets are compiled in parallel.
+
+require 'digest'
+require 'etc'
+require 'json'
+require 'open3'
+require 'shellwords'
+require 'tmpdir'
+
+module Jekyll
+  module Snippets
+    DEFAULTS = {
+      'enabled'  => true,
+      'compiler' => 'g++',
+      'flags'    => %w(-O2 -Wall -Wextra),
+      'timeout'  => 10,
+      'workers'  => nil
+    }.freeze
+
+    # A fenced block immediately followed by its block IAL.
+    BLOCK = /^(?<fence>`{3,}|~{3,})[ \t]*(?<lang>[^\s`{]*)[^\n]*\n(?<code>.*?)^\k<fence>[ \t]*\n(?<ial>\{:[^}\n]*\})[ \t]*$/m.freeze
+    ATTRIBUTE = /([\w-]+)="([^"]*)"/.freeze
+
+    Result = Struct.new(:status, :stdout, :stderr, :millis, keyword_init: true) do
+      def compiled?
+        status != 'compile_error'
+      end
+    end
+
+    class << self
+      def config(site)
+        DEFAULTS.merge(site.config['snippets'] || {})
+      end
+
+      def cache
+        @cache ||= Jekyll::Cache.new('Jekyll::Snippets')
+      end
+
+      def store(key, value)
+        (@lock ||= Mutex.new).synchronize { cache[key] = value }
+      end
+
+      def attributes(ial)
+        ial.scan(ATTRIBUTE).to_h
+      end
+
+      def compiler_id(compiler)
+        (@compiler_ids ||= {})[compiler] ||= `#{ compiler } --version 2>&1`.lines.first.to_s.strip
+      end
+
+      def digest(*parts)
+        Digest::SHA256.hexdigest(JSON.generate(parts))
+      end
+
+      # Runs the block for every job on `workers` threads. Each job spends its
+      # time in a child process, so threads are enough to use every core.
+      def parallel(jobs, workers)
+        queue = Queue.new
+        jobs.each { |job| queue << job }
+        queue.close
+
+        Array.new([workers.to_i, jobs.size].min) do
+          Thread.new do
+            while (job = queue.pop)
+              yield job
+            end
+          end
+        end.each(&:join)
+      end
+
+      # Compiles `code` into `dir` and returns the executable, or raises with
+      # the compiler diagnostics. `libs` go after the source for the linker.
+      def compile(code, dir, compiler, flags, libs = [])
+        source = File.join(dir, 'snippet.cpp')
+        binary = File.join(dir, 'snippet')
+        File.write(source, code)
+
+        _, stderr, status = Open3.capture3(*Shellwords.split(compiler), *flags, source, '-o', binary, *libs)
+        raise CompileError, stderr.gsub("#{ dir }/", '') unless status.success?
+
+        binary
+      end
+
+      def run(code, compiler, flags, timeout)
+        Dir.mktmpdir('snippet') do |dir|
+          binary = compile(code, dir, compiler, flags)
+          started = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+          stdout, stderr, status = Open3.capture3('timeout', timeout.to_s, binary, chdir: dir)
+          millis = ((Process.clock_gettime(Process::CLOCK_MONOTONIC) - started) * 1000).round(1)
+
+          state = if status.exitstatus == 124 then 'timeout'
+                  elsif status.success? then 'ok'
+                  else "exit #{ status.exitstatus || status.termsig }"
+                  end
+
+          Result.new(status: state, stdout: stdout, stderr: stderr, millis: millis)
+        end
+      rescue CompileError => e
+        Result.new(status: 'compile_error', stdout: '', stderr: e.message, millis: nil)
+      end
+
+      # Fenced text block that cannot be closed early by its own content, and
+      # whose content is not picked up by Liquid.
+      def fenced(text, klass, liquid: true)
+        fence = '~' * [3, text.scan(/^~+/).map(&:size).max.to_i + 1].max
+        block = "#{ fence } text\n#{ text.chomp }\n#{ fence }"
+        block = "{% raw %}#{ block }{% endraw %}" if liquid
+        "#{ block }\n{: .#{ klass } .nolineno }\n"
+      end
+    end
+
+    class CompileError < StandardError; end
+
+    class Generator < Jekyll::Generator
+      safe true
+      priority :normal
+
+      # `posts` lets the preview server transform a single re-read post.
+      def generate(site, posts = site.posts.docs.select { |post| BuildShards.render?(post) })
+        config = Snippets.config(site)
+        return unless config['enabled']
+
+        jobs = {}
+        posts.each do |post|
+          post.content.scan(BLOCK) { jobs.merge!(job(Regexp.last_match, config)) }
+        end
+        return if jobs.empty?
+
+        pending = jobs.reject { |key, _| Snippets.cache.key?(key) }
+        unless pending.empty?
+          workers = config['workers'] || Etc.nprocessors
+          Jekyll.logger.info 'Snippets:', "Compiling #{ pending.size } snippet(s) with #{ workers } worker(s)"
+
+          Snippets.parallel(pending.to_a, workers) do |key, (code, flags)|
+            result = Snippets.run(code, config['compiler'], flags, config['timeout'])
+            Snippets.store(key, result.to_h)
+          end
+        end
+
+        posts.each do |post|
+          post.content = post.content.gsub(BLOCK) do |block|
+            key = job(Regexp.last_match, config).keys.first
+            key ? block + render(Snippets::Result.new(**Snippets.cache[key]), post) : block
+          end
+        end
+      end
+
+      private
+
+      def job(match, config)
+        attributes = Snippets.attributes(match[:ial])
+        return {} unless attributes['run']
+
+        flags = ["-std=#{ attributes['run'] }", *config['flags'], *Shellwords.split(attributes['flags'].to_s)]
+        key = Snippets.digest(match[:code], flags, config['compiler'], Snippets.compiler_id(config['compiler']))
+        { key => [match[:code], flags] }
+      end
+
+      def render(result, post)
+        liquid = post.data['render_with_liquid'] != false
+
+        unless result.compiled?
+          Jekyll.logger.warn 'Snippets:', "A snippet in #{ post.relative_path } does not compile"
+          return "\n\n#{ Snippets.fenced(result.stderr, 'snippet-error', liquid: liquid) }"
+        end
+
+        meta = "*#{ result.status == 'ok' ? 'Ran' : "Failed (#{ result.status })" } in #{ result.millis } ms*\n{: .snippet-meta }\n"
+        output = [meta]
+        output << Snippets.fenced(result.stdout, 'snippet-output', liquid: liquid) unless result.stdout.empty?
+        output << Snippets.fenced(result.stderr, 'snippet-stderr', liquid: liquid) unless result.stderr.empty?
+        "\n\n#{ output.join("\n") }"
+      end
+    end
+  end
+end
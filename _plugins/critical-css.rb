@@ -0,0 +1,156 @@
+#!/usr/bin/env ruby
+#
+# Inline critical CSS per layout
+#
+# Once everything is rendered, the rules of the site stylesheet that apply
+# to the top of a page are inlined into its `<head>`, and the stylesheet
+# itself is loaded without blocking rendering. "The top of a page" is the
+# first `critical_css.fold` bytes of the body of the first page using each
+# layout: a rule is kept when the tag, classes and id of the subject of
+# one of its selectors all occur there. The result is cached by layout
+# and stylesheet digest. This runs after `compress-html.rb`, which drops
+# `</head>` with `endings: all`, so the head is taken as everything before
+# `<body`.
+
+require 'digest'
+require 'set'
+
+module Jekyll
+  module CriticalCss
+    DEFAULTS = {
+      'enabled' => true,
+      'layouts' => %w(home post page archives category tag categories tags),
+      'fold'    => 16_384
+    }.freeze
+
+    STYLESHEET = /<link\b[^>]*\brel=["']?stylesheet["']?[^>]*>/i.freeze
+    ALWAYS = /\A(?:\*|html|body|:root)\z/.freeze
+
+    class << self
+      def cache
+        @cache ||= Jekyll::Cache.new('Jekyll::CriticalCss')
+      end
+
+      def run(site)
+        config = DEFAULTS.merge(site.config['critical_css'] || {})
+        return unless config['enabled']
+
+        stylesheets = site.pages.select { |page| page.output_ext == '.css' && page.output }
+                                .to_h { |page| [page.url, page.output] }
+        return if stylesheets.empty?
+
+        critical = {}
+        candidates = 0
+        (site.documents + site.pages).each do |doc|
+          next unless doc.output_ext == '.html' && doc.output
+          next unless config['layouts'].include?(doc.data['layout'])
+
+          candidates += 1
+          links = head(doc.output).scan(STYLESHEET)
+          local = links.filter_map do |link|
+            href = link[/\bhref=["']?([^"'\s>]+)/i, 1].to_s.delete_prefix(site.baseurl.to_s)
+            [link, stylesheets[href]] if stylesheets.key?(href)
+          end
+          next if local.empty?
+
+          css = local.map(&:last).join
+          key = "#{ doc.data['layout'] }|#{ Digest::SHA256.hexdigest(css) }|#{ config['fold'] }"
+          critical[key] ||= cache.getset(key) { extract(css, doc.output, config['fold']) }
+          doc.output = inline(doc.output, local.map(&:first), critical[key])
+        end
+
+        Jekyll.logger.warn 'Critical CSS:', "No page links #{ stylesheets.keys.join(', ') } in its head" if candidates.positive? && critical.empty?
+      end
+
+      private
+
+      def head(html)
+        html[/\A.*?(?=<body\b)/im] || html
+      end
+
+      def extract(css, html, fold)
+        body = html[/<body\b.*/im].to_s[0, fold]
+        tokens = Set.new
+        body.scan(/<([a-z][a-z0-9-]*)/i) { tokens << Regexp.last_match(1).downcase }
+        body.scan(/\bclass=["']([^"']*)["']/i) { Regexp.last_match(1).split.each { |c| tokens << ".#{ c }" } }
+        body.scan(/\bid=["']([^"']*)["']/i) { tokens << "##{ Regexp.last_match(1) }" }
+
+        filter(blocks(css), tokens)
+      end
+
+      # Splits a stylesheet into `[prelude, body]` pairs, keeping nesting
+      # (for `@media` and friends) as the raw body.
+      def blocks(css)
+        css = css.gsub(%r{/\*.*?\*/}m, '')
+        result = []
+        depth = 0
+        start = 0
+        prelude = nil
+        quote = nil
+
+        css.each_char.with_index do |char, i|
+          if quote
+            quote = nil if char == quote && css[i - 1] != '\\'
+          elsif char == '"' || char == "'"
+            quote = char
+          elsif char == '{'
+            prelude = css[start...i].strip if depth.zero?
+            start = i + 1 if depth.zero?
+            depth += 1
+          elsif char == '}'
+            depth -= 1
+            if depth.zero?
+              result << [prelude, css[start...i]]
+              start = i + 1
+            end
+          elsif char == ';' && depth.zero?
+            result << [css[start...i].strip, nil]
+            start = i + 1
+          end
+        end
+
+        result
+      end
+
+      def filter(blocks, tokens)
+        blocks.filter_map do |prelude, body|
+          if body.nil?
+            "#{ prelude };" if prelude.start_with?('@charset')
+          elsif prelude.match?(/\A@(?:media|supports|layer)\b/i)
+            inner = filter(blocks(body), tokens)
+            "#{ prelude }{#{ inner }}" unless inner.empty?
+          elsif prelude.start_with?('@')
+            nil
+          elsif prelude.split(',').any? { |selector| matches?(selector, tokens) }
+            "#{ prelude }{#{ body }}"
+          end
+        end.join
+      end
+
+      def matches?(selector, tokens)
+        subject = selector.strip.split(/\s*[\s>+~]\s*/).last.to_s
+        subject = subject.gsub(/::?[a-z-]+(?:\([^)]*\))?/i, '').gsub(/\[[^\]]*\]/, '')
+        return true if subject.empty? || subject.match?(ALWAYS)
+
+        subject.scan(/[.#]?[a-z0-9_-]+/i).all? do |part|
+          part.match?(/\A[.#]/) ? tokens.include?(part) : tokens.include?(part.downcase)
+        end
+      end
+
+      def inline(html, links, css)
+        return html if css.empty? || html.include?('id="critical-css"')
+
+        html = html.sub(%r{<head\b[^>]*>}i) { |head| %(#{ head }<style id="critical-css">#{ css }</style>) }
+        links.each do |link|
+          preload = link.sub(/\brel=["']?stylesheet["']?/i, %(rel="preload" as="style" onload="this.onload=null;this.rel='stylesheet'"))
+          html = html.sub(link) { "#{ preload }<noscript>#{ link }</noscript>" }
+        end
+        html
+      end
+    end
+  end
+end
+
+Jekyll::Hooks.register :site, :post_render do |site|
+  Jekyll::CriticalCss.run(site)
+end
@@ -0,0 +1,188 @@
+#!/usr/bin/env ruby
+#
+# Stream the Atom feed and the sitemap to disk
+#
+# The theme's `feed.xml` and jekyll-sitemap's `sitemap.xml` are Liquid
+# templates that build the whole document as one string over `site.posts`.
+# Both pages are dropped before rendering, and the files are written after
+# the site instead, one entry at a time, so only the entry being written
+# is held beyond the rendered posts. `updated` and `lastmod` come from
+# `last_modified_at` (see `posts-lastmod-hook.rb`), falling back to the
+# post date. The converted HTML of each post is kept in a Jekyll::Cache
+# keyed by the digest of its source, for the posts an incremental build
+# does not render.
+
+require 'cgi'
+require 'digest'
+require 'time'
+
+module Jekyll
+  module FeedSitemap
+    DEFAULTS = {
+      'enabled'  => true,
+      'path'     => 'feed.xml',
+      'limit'    => 20,
+      'truncate' => 0 # characters of plain text in <summary>, 0 for the full post in <content>
+    }.freeze
+
+    SITEMAP = 'sitemap.xml'
+    SITEMAP_STATIC = %w(.html .htm .pdf).freeze
+
+    class << self
+      def config(site)
+        DEFAULTS.merge(site.config['feed'] || {})
+      end
+
+      def enabled?(site)
+        config(site)['enabled'] != false
+      end
+
+      def cache
+        @cache ||= Jekyll::Cache.new('Jekyll::FeedSitemap')
+      end
+
+      def remember(post)
+        cache[key(post)] = post.content
+      end
+
+      def drop_templates(site)
+        paths = ["/#{ config(site)['path'] }", "/#{ SITEMAP }"]
+        site.pages.reject! { |page| paths.include?(page.url) }
+      end
+
+      def write(site)
+        limit = config(site)['limit'].to_i
+        posts = site.posts.docs.reject { |post| post.data['published'] == false }
+        posts = posts.sort_by { |post| -post.date.to_i }
+
+        stream(site, config(site)['path']) { |io| feed(site, posts.first(limit), io) }
+        stream(site, SITEMAP) { |io| sitemap(site, io) }
+      end
+
+      private
+
+      def stream(site, path)
+        file = site.in_dest_dir(path)
+        FileUtils.mkdir_p(File.dirname(file))
+        File.open("#{ file }.tmp", 'w') { |io| yield io }
+        File.rename("#{ file }.tmp", file)
+      end
+
+      def key(post)
+        Digest::SHA256.hexdigest([post.relative_path, File.read(post.path)].join("\0"))
+      end
+
+      # Without output the post was not rendered and its content is still
+      # the Markdown source.
+      def html(post)
+        return post.content unless post.output.nil?
+
+        key = key(post)
+        return cache[key] if cache.key?(key)
+
+        Jekyll.logger.warn 'Feed:', "#{ post.relative_path } was neither rendered nor cached"
+        ''
+      end
+
+      def xml(value)
+        CGI.escapeHTML(value.to_s)
+      end
+
+      def absolute(site, url)
+        "#{ site.config['url'] }#{ site.baseurl }#{ url }"
+      end
+
+      # `last_modified_at` is the git date string set by the lastmod hook.
+      def updated(item)
+        value = item.data['last_modified_at'] || item.data['date'] || Time.now
+        (value.is_a?(String) ? Time.parse(value) : value.to_time).xmlschema
+      end
+
+      def feed(site, posts, io)
+        config = config(site)
+        author = site.config.dig('social', 'name')
+        link = absolute(site, "/#{ config['path'] }")
+
+        io << %(<?xml version="1.0" encoding="utf-8"?>\n)
+        io << %(<feed xmlns="http://www.w3.org/2005/Atom">\n)
+        io << %(<id>#{ xml(absolute(site, '/')) }</id>\n)
+        io << %(<title>#{ xml(site.config['title']) }</title>\n)
+        io << %(<subtitle>#{ xml(site.config['description'].to_s.strip) }</subtitle>\n)
+        io << %(<updated>#{ posts.map { |post| updated(post) }.max || Time.now.xmlschema }</updated>\n)
+        io << %(<author><name>#{ xml(author) }</name><uri>#{ xml(absolute(site, '/')) }</uri></author>\n)
+        io << %(<link rel="self" type="application/atom+xml" href="#{ xml(link) }"/>\n)
+        io << %(<link rel="alternate" type="text/html" hreflang="#{ xml(site.config['lang']) }" href="#{ xml(absolute(site, '/')) }"/>\n)
+        io << %(<generator uri="https://jekyllrb.com/" version="#{ Jekyll::VERSION }">Jekyll</generator>\n)
+        io << %(<rights>© #{ Time.now.year } #{ xml(author) }</rights>\n)
+        io << %(<icon>#{ xml(absolute(site, '/assets/img/favicons/favicon.ico')) }</icon>\n)
+        io << %(<logo>#{ xml(absolute(site, '/assets/img/favicons/favicon-96x96.png')) }</logo>\n)
+
+        posts.each { |post| io << entry(site, post, config['truncate'].to_i) }
+        io << %(</feed>\n)
+      end
+
+      def entry(site, post, truncate)
+        url = absolute(site, post.url)
+        categories = Array(post.data['categories']) + Array(post.data['tags'])
+        out = +"<entry>\n"
+        out << %(<title>#{ xml(post.data['title']) }</title>\n)
+        out << %(<link href="#{ xml(url) }" rel="alternate" type="text/html" title="#{ xml(post.data['title']) }"/>\n)
+        out << %(<published>#{ post.date.xmlschema }</published>\n)
+        out << %(<updated>#{ updated(post) }</updated>\n)
+        out << %(<id>#{ xml(url) }</id>\n)
+        out << %(<author><name>#{ xml(post.data['author'] || site.config.dig('social', 'name')) }</name></author>\n)
+        categories.uniq.each { |term| out << %(<category term="#{ xml(term) }"/>\n) }
+
+        if truncate.positive?
+          out << %(<summary>#{ xml(summary(post, truncate)) }</summary>\n)
+        else
+          out << %(<summary>#{ xml(post.data['description'] || summary(post, 400)) }</summary>\n)
+          out << %(<content type="html">#{ xml(html(post)) }</content>\n)
+        end
+        out << "</entry>\n"
+      end
+
+      def summary(post, length)
+        text = CGI.unescapeHTML(html(post).to_s.gsub(%r{<(script|style)\b.*?</\1>}im, ' ').gsub(/<[^>]*>/, ' '))
+        text = text.gsub(/\s+/, ' ').strip
+        text.length > length ? "#{ text[0, length].sub(/\s+\S*\z/, '') }…" : text
+      end
+
+      def sitemap(site, io)
+        io << %(<?xml version="1.0" encoding="UTF-8"?>\n)
+        io << %(<urlset xmlns="http://www.sitemaps.org/schemas/sitemap/0.9">\n)
+
+        documents = site.collections.each_value.flat_map(&:docs).select(&:write?)
+        (documents + site.pages).each do |item|
+          next if item.data['sitemap'] == false || item.data['redirect_to']
+          next unless %w(.html .htm).include?(item.output_ext)
+          next if item.url == '/404.html'
+
+          io << %(<url><loc>#{ xml(absolute(site, item.url)) }</loc>)
+          io << %(<lastmod>#{ updated(item) }</lastmod>) if item.data['last_modified_at'] || item.data['date']
+          io << %(</url>\n)
+        end
+
+        site.static_files.each do |file|
+          next unless SITEMAP_STATIC.include?(file.extname) && file.write? && file.data['sitemap'] != false
+
+          io << %(<url><loc>#{ xml(absolute(site, file.url)) }</loc><lastmod>#{ file.modified_time.xmlschema }</lastmod></url>\n)
+        end
+
+        io << %(</urlset>\n)
+      end
+    end
+  end
+end
+
+Jekyll::Hooks.register :site, :pre_render do |site|
+  Jekyll::FeedSitemap.drop_templates(site) if Jekyll::FeedSitemap.enabled?(site)
+end
+
+Jekyll::Hooks.register :posts, :post_render do |post|
+  Jekyll::FeedSitemap.remember(post) if Jekyll::FeedSitemap.enabled?(post.site)
+end
+
+Jekyll::Hooks.register :site, :post_write, priority: :high do |site|
+  Jekyll::FeedSitemap.write(site) if Jekyll::FeedSitemap.enabled?(site)
+end
@@ -0,0 +1,149 @@
+#!/usr/bin/env ruby
+#
+# Subset the self-hosted fonts
+#
+# With `assets.self_host.enabled`, the theme serves Font Awesome and the
+# web fonts from `assets/lib` (chirpy-static-assets). After the site is
+# written, the Font Awesome webfonts are cut down to the icons used in the
+# output, in the theme's scripts, in `_data/share.yml`/`_data/contact.yml`
+# and in `font_subset.keep`, the text fonts to the characters that appear
+# in the pages, and preload hints for the critical fonts are added to
+# every page. Subsets are always made from the fonts in the source
+# `assets/lib` with `pyftsubset` (fonttools) and cached by font digest and
+# glyph set.
+
+require 'cgi'
+require 'digest'
+require 'set'
+require 'shellwords'
+
+module Jekyll
+  module FontSubset
+    DEFAULTS = {
+      'enabled'  => true,
+      'command'  => 'pyftsubset',
+      'icons'    => 'fontawesome-free/webfonts/*.woff2',
+      'fonts'    => 'fonts/**/*.woff2',
+      'scripts'  => 'assets/js/**/*.js', # output scripts that add icons at runtime
+      'keep'     => [],
+      'preload'  => ['fontawesome-free/webfonts/fa-solid-900.woff2', 'fontawesome-free/webfonts/fa-brands-400.woff2']
+    }.freeze
+
+    ICON = /\bfa-[a-z0-9-]+/.freeze
+    # `.fa-github:before{content:"\f09b"}` as well as `.fa-github{--fa:"\f09b"}`
+    ICON_RULE = /((?:\.fa-[a-z0-9-]+(?::{1,2}before)?\s*,?\s*)+)\{\s*(?:content|--fa)\s*:\s*["']\\([0-9a-f]+)["']/i.freeze
+
+    class << self
+      def config(site)
+        DEFAULTS.merge(site.config['font_subset'] || {})
+      end
+
+      def enabled?(site)
+        self_host = site.config.dig('assets', 'self_host') || {}
+        env = self_host['env']
+
+        config(site)['enabled'] && self_host['enabled'] && (env.nil? || env.to_s.empty? || env == Jekyll.env)
+      end
+
+      def run(site)
+        return unless enabled?(site)
+
+        lib = File.join(site.dest, 'assets', 'lib')
+        source = site.in_source_dir('assets', 'lib')
+        return unless File.directory?(lib) && File.directory?(source)
+
+        config = config(site)
+        pages = Dir.glob(File.join(site.dest, '**', '*.html'))
+        icons = Set.new(Array(config['keep']))
+        text = Set.new((0x20..0x7e).to_a)
+
+        pages.each do |page|
+          html = File.read(page)
+          icons.merge(html.scan(ICON))
+          stripped = html.gsub(%r{<(script|style)\b.*?</\1>}im, '').gsub(/<[^>]*>/, '')
+          text.merge(CGI.unescapeHTML(stripped).each_codepoint)
+        end
+        %w(share.yml contact.yml).each do |name|
+          file = site.in_source_dir(site.config['data_dir'] || '_data', name)
+          icons.merge(File.read(file).scan(ICON)) if File.file?(file)
+        end
+        Dir.glob(config['scripts'], base: site.dest).each do |script|
+          icons.merge(File.read(File.join(site.dest, script)).scan(ICON))
+        end
+
+        glyphs = icon_codepoints(source, icons)
+        subset(site, source, lib, config['icons'], glyphs, config)
+        subset(site, source, lib, config['fonts'], text.to_a, config)
+        preload(site, pages, lib, config)
+      end
+
+      private
+
+      def icon_codepoints(lib, icons)
+        Dir.glob(File.join(lib, 'fontawesome-free', 'css', '*.css')).flat_map do |css|
+          File.read(css).scan(ICON_RULE).filter_map do |selectors, codepoint|
+            codepoint.to_i(16) if selectors.scan(ICON).any? { |name| icons.include?(name) }
+          end
+        end.uniq
+      end
+
+      # Subsets the fonts matching `pattern` in `source` over their copies
+      # in `lib`, so a font is never cut from an earlier subset.
+      def subset(site, source, lib, pattern, codepoints, config)
+        return if codepoints.empty?
+
+        unicodes = codepoints.sort.map { |c| format('U+%04X', c) }.join(',')
+
+        Dir.glob(pattern, base: source).each do |rel|
+          font = File.join(source, rel)
+          target = File.join(lib, rel)
+          next unless File.file?(target)
+
+          key = Digest::SHA256.hexdigest("#{ Digest::SHA256.file(font).hexdigest }|#{ unicodes }")
+          cached = site.in_cache_dir('font-subset', "#{ key }.woff2")
+
+          unless File.file?(cached)
+            FileUtils.mkdir_p(File.dirname(cached))
+            ok = system(*Shellwords.split(config['command']), font, "--unicodes=#{ unicodes }",
+                        '--flavor=woff2', '--layout-features=*', "--output-file=#{ cached }",
+                        out: File::NULL, err: File::NULL)
+            unless ok
+              Jekyll.logger.warn 'Font subset:', "Could not subset #{ font.delete_prefix(site.source) }"
+              next
+            end
+          end
+
+          FileUtils.cp(cached, target)
+        end
+      end
+
+      def preload(site, pages, lib, config)
+        links = Array(config['preload']).filter_map do |rel|
+          next unless File.file?(File.join(lib, rel))
+
+          href = "#{ site.baseurl }/assets/lib/#{ rel }"
+          %(<link rel="preload" href="#{ href }" as="font" type="font/woff2" crossorigin>)
+        end
+        return if links.empty?
+
+        # Right after `<head>`: with `compress_html.endings` there is no `</head>`.
+        tags = links.join
+        pages.each do |page|
+          html = File.read(page)
+          next if html.include?(tags)
+
+          unless html.match?(/<head\b[^>]*>/i)
+            Jekyll.logger.warn 'Font subset:', "No <head> in #{ page.delete_prefix(site.dest) }, fonts not preloaded"
+            next
+          end
+
+          File.write(page, html.sub(/<head\b[^>]*>/i) { |head| "#{ head }#{ tags }" })
+        end
+      end
+    end
+  end
+end
+
+Jekyll::Hooks.register :site, :post_write, priority: :high do |site|
+  Jekyll::FontSubset.run(site)
+end
@@ -0,0 +1,183 @@
+#!/usr/bin/env ruby
+#
+# Compiler Explorer panes that load on demand
+#
+#     {% godbolt std="c++23" flags="-O2" compiler="g132" %}
+#     int square(int x) { return x * x; }
+#     {% endgodbolt %}
+#
+# renders the code highlighted with Rouge and, when it compiles, the
+# assembly next to it. The Compiler Explorer iframe only replaces the
+# snapshot once "Open in editor" is clicked; without JavaScript the button
+# is a plain link to godbolt.org. The assembly comes from the local
+# compiler of `snippets.compiler`, or from godbolt's API with `asm: api`,
+# and is kept in a Jekyll::Cache keyed by the digest of the source, the
+# flags and the compiler.
+
+require 'base64'
+require 'cgi'
+require 'json'
+require 'net/http'
+require 'open3'
+require 'shellwords'
+require 'tmpdir'
+require_relative 'cpp-snippets'
+
+module Jekyll
+  module Godbolt
+    DEFAULTS = {
+      'compiler' => 'g132', # Compiler Explorer id of the compiler opened in the editor
+      'std'      => 'c++23',
+      'flags'    => '-O2',
+      'asm'      => 'local', # [local | api | none]
+      'api'      => 'https://godbolt.org/api',
+      'timeout'  => 20
+    }.freeze
+
+    URL = 'https://godbolt.org'
+
+    class << self
+      def config(site)
+        DEFAULTS.merge(site.config['godbolt'] || {})
+      end
+
+      def cache
+        @cache ||= Jekyll::Cache.new('Jekyll::Godbolt')
+      end
+
+      # Returns the assembly listing or nil when the code does not compile.
+      def assembly(site, code, compiler, options)
+        config = config(site)
+        return if config['asm'] == 'none'
+
+        local = Snippets.config(site)['compiler']
+        id = config['asm'] == 'api' ? compiler : Snippets.compiler_id(local)
+        key = Snippets.digest(code, options, config['asm'], id)
+        return cache[key] if cache.key?(key)
+
+        listing = config['asm'] == 'api' ? remote(config, code, compiler, options) : compile(local, code, options)
+        cache[key] = listing
+      rescue CompileError => e
+        Jekyll.logger.warn 'Godbolt:', "A snippet does not compile:\n#{ e.message }"
+        cache[key] = nil
+      rescue StandardError => e
+        # Not cached, so the next build tries again.
+        Jekyll.logger.warn 'Godbolt:', "No assembly (#{ e.class }: #{ e.message })"
+        nil
+      end
+
+      def clientstate(code, compiler, options)
+        state = {
+          'sessions' => [{
+            'id' => 1, 'language' => 'c++', 'source' => code,
+            'compilers' => [{ 'id' => compiler, 'options' => options }]
+          }]
+        }
+        "#{ URL }/clientstate/#{ CGI.escape(Base64.strict_encode64(JSON.generate(state))) }"
+      end
+
+      private
+
+      def compile(compiler, code, options)
+        Dir.mktmpdir('godbolt') do |dir|
+          source = File.join(dir, 'snippet.cpp')
+          File.write(source, code)
+
+          flags = %w(-S -o - -masm=intel -fno-asynchronous-unwind-tables -g0)
+          asm, stderr, status = Open3.capture3(*Shellwords.split(compiler), *Shellwords.split(options), *flags, source)
+          raise CompileError, stderr.gsub("#{ dir }/", '') unless status.success?
+
+          demangle(filter(asm))
+        end
+      end
+
+      # The same cleanup as Compiler Explorer's default filters: directives
+      # and the labels only they refer to are dropped.
+      def filter(asm)
+        asm.lines.reject do |line|
+          line =~ /^\s*\.(?!L\w*:)/ || line =~ /^\.L(FB|FE|VL|BB|BE|LST)\d*:/ || line =~ /^\s*(#|$)/
+        end.join
+      end
+
+      def demangle(asm)
+        out, status = Open3.capture2('c++filt', stdin_data: asm)
+        status.success? ? out : asm
+      rescue SystemCallError
+        asm
+      end
+
+      def remote(config, code, compiler, options)
+        uri = URI("#{ config['api'] }/compiler/#{ compiler }/compile")
+        body = {
+          'source'  => code,
+          'options' => {
+            'userArguments' => options,
+            'filters'       => { 'intel' => true, 'directives' => true, 'labels' => true,
+                                 'commentOnly' => true, 'demangle' => true }
+          }
+        }
+
+        response = Net::HTTP.start(uri.host, uri.port, use_ssl: uri.scheme == 'https',
+                                   open_timeout: config['timeout'], read_timeout: config['timeout']) do |http|
+          http.post(uri.path, JSON.generate(body), 'Content-Type' => 'application/json', 'Accept' => 'application/json')
+        end
+        raise "HTTP #{ response.code }" unless response.is_a?(Net::HTTPSuccess)
+
+        result = JSON.parse(response.body)
+        raise CompileError, Array(result['stderr']).map { |l| l['text'] }.join("\n") unless result['code'].to_i.zero?
+
+        Array(result['asm']).map { |l| l['text'] }.join("\n")
+      end
+    end
+
+    class CompileError < StandardError; end
+
+    class Tag < Liquid::Block
+      ATTRIBUTE = /([\w-]+)="([^"]*)"/.freeze
+
+      def initialize(tag_name, markup, tokens)
+        super
+        @attributes = markup.scan(ATTRIBUTE).to_h
+      end
+
+      def render(context)
+        site = context.registers[:site]
+        config = Godbolt.config(site)
+        code = super.sub(/\A\n/, '').rstrip + "\n"
+        compiler = @attributes['compiler'] || config['compiler']
+        options = "-std=#{ @attributes['std'] || config['std'] } #{ @attributes['flags'] || config['flags'] }".strip
+        asm = Godbolt.assembly(site, code, compiler, options)
+        url = Godbolt.clientstate(code, compiler, options)
+
+        out = +%(<div class="godbolt mb-3">\n)
+        out << highlight(code, 'cpp')
+        if asm
+          out << %(<details class="godbolt-asm"><summary class="small text-muted">Assembly (<code>#{ CGI.escapeHTML(options) }</code>)</summary>\n)
+          out << highlight(asm, 'nasm') << "</details>\n"
+        end
+        out << %(<a class="btn btn-outline-secondary btn-sm mt-2 godbolt-open" href="#{ url }" target="_blank" rel="noopener">Open in editor</a>\n)
+        out << %(</div>\n)
+        out << script(context)
+      end
+
+      private
+
+      def highlight(code, lang)
+        lexer = Rouge::Lexer.find(lang) || Rouge::Lexers::PlainText
+        html = Rouge::Formatters::HTML.new.format(lexer.lex(code))
+        %(<div class="language-#{ lang } highlighter-rouge"><div class="highlight"><pre class="highlight"><code>#{ html }</code></pre></div></div>\n)
+      end
+
+      # Once per page.
+      def script(context)
+        return '' if context.registers[:godbolt_script]
+
+        context.registers[:godbolt_script] = true
+        src = "#{ context.registers[:site].baseurl }/assets/js/godbolt.js"
+        %(<script defer src="#{ src }"></script>\n)
+      end
+    end
+  end
+end
+
+Liquid::Template.register_tag('godbolt', Jekyll::Godbolt::Tag)
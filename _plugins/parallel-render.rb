@@ -0,0 +1,157 @@
+#!/usr/bin/env ruby
+#
+# Render documents and pages in forked worker processes
+#
+# Opt in with `parallel_render.enabled`. Reading, generating and the
+# `:site, :pre_render` hooks (the git history index, Rouge prewarming,
+# ...) still happen once in the parent. Rendering is then split into two
+# rounds, collection documents first and pages second, since pages such
+# as the home page or the feed use the converted content of the posts.
+# In each round the items are spread over the workers by size, every
+# worker renders its share including the `:post_render` hooks, and the
+# parent merges the outputs back before writing the site as usual.
+#
+# Side effects of hooks other than on the rendered item itself are lost
+# in the workers, except for Jekyll::Cache entries, which go to disk, and
+# the layout and include dependencies recorded for `--incremental`,
+# which the workers send back and the parent adds to its regenerator.
+
+require 'etc'
+
+module Jekyll
+  module ParallelRender
+    DEFAULTS = {
+      'enabled'   => false,
+      'workers'   => nil,
+      'min_items' => 32
+    }.freeze
+
+    class WorkerError < StandardError; end
+
+    class << self
+      def config(site)
+        DEFAULTS.merge(site.config['parallel_render'] || {})
+      end
+
+      def workers(site, items)
+        config = config(site)
+        return 1 unless config['enabled'] && Process.respond_to?(:fork) && items.size >= config['min_items'].to_i
+
+        [(config['workers'] || Etc.nprocessors).to_i, items.size].min
+      end
+
+      # Longest-first greedy split, so slices take roughly as long to render.
+      def partition(items, count)
+        slices = Array.new(count) { [] }
+        loads = Array.new(count, 0)
+
+        items.each_with_index.sort_by { |item, _| -item.content.to_s.bytesize }.each do |item, index|
+          slot = loads.each_with_index.min_by(&:first).last
+          slices[slot] << index
+          loads[slot] += item.content.to_s.bytesize
+        end
+
+        slices
+      end
+
+      def render(site, items, payload)
+        count = workers(site, items)
+        return false if count < 2
+
+        workers = partition(items, count).map do |slice|
+          reader, writer = IO.pipe
+          pid = fork do
+            reader.close
+            Marshal.dump(render_slice(site, items, slice, payload), writer)
+            writer.close
+            exit!(0)
+          end
+          writer.close
+          [pid, reader]
+        end
+
+        workers.each do |pid, reader|
+          results = begin
+            Marshal.load(reader)
+          rescue EOFError
+            [:error, "render worker #{ pid } exited without results"]
+          end
+          reader.close
+          Process.wait(pid)
+          raise WorkerError, results.last if results.first == :error
+
+          merge(items, results[1])
+          replay(site, results[2])
+        end
+
+        true
+      end
+
+      private
+
+      def render_slice(site, items, slice, payload)
+        before = dependencies(site)
+        results = slice.filter_map do |index|
+          item = items[index]
+          site.send(:render_regenerated, item, payload)
+          next if item.output.nil?
+
+          excerpt = item.data['excerpt'] if item.respond_to?(:data)
+          excerpt = nil unless excerpt.respond_to?(:output)
+          [index, item.output, item.content, excerpt&.content, excerpt&.output]
+        end
+
+        added = dependencies(site).filter_map do |path, deps|
+          new = deps - before.fetch(path, [])
+          [path, new] unless new.empty?
+        end
+
+        [:ok, results, added]
+      rescue StandardError => e
+        [:error, "#{ e.class }: #{ e.message }\n#{ e.backtrace.first(5).join("\n") }"]
+      end
+
+      def dependencies(site)
+        site.regenerator.metadata.transform_values { |entry| Array(entry['deps']).dup }
+      end
+
+      # Entries of items new to the metadata were only added in the worker.
+      def replay(site, added)
+        regenerator = site.regenerator
+        added.each do |path, deps|
+          regenerator.add(path) unless regenerator.metadata.key?(path)
+          deps.each { |dep| regenerator.add_dependency(path, dep) }
+        end
+      end
+
+      def merge(items, results)
+        results.each do |index, output, content, excerpt_content, excerpt_output|
+          item = items[index]
+          item.output = output
+          item.content = content
+
+          excerpt = item.data['excerpt'] if item.respond_to?(:data)
+          next unless excerpt.respond_to?(:output=)
+
+          excerpt.content = excerpt_content unless excerpt_content.nil?
+          excerpt.output = excerpt_output unless excerpt_output.nil?
+        end
+      end
+    end
+
+    module SiteRender
+      private
+
+      def render_docs(payload)
+        docs = collections.each_value.flat_map(&:docs)
+        super unless ParallelRender.render(self, docs, payload)
+      end
+
+      def render_pages(payload)
+        super unless ParallelRender.render(self, pages, payload)
+      end
+    end
+
+    Jekyll::Site.prepend SiteRender
+  end
+end
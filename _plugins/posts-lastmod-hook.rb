@@ -1,13 +1,115 @@
 #!/usr/bin/env ruby
 #
 # Check for changed posts
+#
+# The history is walked once per build and indexed by path, so that
+# `post_init` only has to do a hash lookup instead of spawning git twice
+# for every post. The index is kept in `.jekyll-cache/lastmod.json` along
+# with the HEAD it was built from; later builds only walk the new commits.
+
+require 'json'
+
+module Jekyll
+  module PostsLastmod
+    class << self
+      attr_reader :index
+
+      def reset(site)
+        @toplevel = `git -C "#{ site.source }" rev-parse --show-toplevel`.strip
+        return @index = {} if @toplevel.empty?
+
+        head = `git -C "#{ @toplevel }" rev-parse HEAD`.strip
+        cache = site.config['disable_disk_cache'] ? nil : site.in_cache_dir('lastmod.json')
+        cached = load_cache(cache)
+
+        @index =
+          if cached.nil?
+            walk
+          elsif cached['head'] == head
+            cached['paths']
+          elsif ancestor?(cached['head'])
+            merge(cached['paths'], walk("#{ cached['head'] }..HEAD"))
+          else
+            walk
+          end
+
+        save_cache(cache, head) unless cached && cached['head'] == head
+      end
+
+      # Returns `[commit_count, last_date]` for the file, as
+      # `git rev-list --count HEAD <path>` and `git log -1 <path>` would.
+      def lookup(path)
+        return if @index.nil? || @index.empty?
+
+        @index[path.delete_prefix("#{ @toplevel }/")]
+      end
+
+      private
+
+      def load_cache(file)
+        return unless file && File.file?(file)
+
+        data = JSON.parse(File.read(file))
+        data if data['head'].is_a?(String) && data['paths'].is_a?(Hash)
+      rescue JSON::ParserError
+        nil
+      end
+
+      def save_cache(file, head)
+        return if file.nil? || head.empty?
+
+        FileUtils.mkdir_p(File.dirname(file))
+        File.write(file, JSON.generate('head' => head, 'paths' => @index))
+      end
+
+      def ancestor?(commit)
+        system('git', '-C', @toplevel, 'merge-base', '--is-ancestor', commit, 'HEAD',
+               out: File::NULL, err: File::NULL)
+      end
+
+      # Commits reachable from HEAD are those reachable from the cached head
+      # plus `cached..HEAD`, so counts add up and newer dates win.
+      def merge(index, delta)
+        delta.each do |path, (count, date)|
+          old = index[path]
+          index[path] = old ? [old[0] + count, date] : [count, date]
+        end
+        index
+      end
+
+      # Each commit is emitted as "\0<date>\n\n<path>\n<path>...", newest first,
+      # so the first date seen for a path is its last modification.
+      def walk(range = "HEAD")
+        log = `git -C "#{ @toplevel }" -c core.quotePath=false log --no-renames --name-only --format=%x00%ad --date=iso #{ range } --`
+        index = {}
+
+        log.split("\0").each do |commit|
+          date, *paths = commit.lines(chomp: true)
+          next if date.nil?
+
+          paths.each do |path|
+            next if path.empty?
+
+            entry = (index[path] ||= [0, date])
+            entry[0] += 1
+          end
+        end
+
+        index
+      end
+    end
+  end
+end
+
+Jekyll::Hooks.register :site, :after_reset do |site|
+  Jekyll::PostsLastmod.reset(site)
+end
 
 Jekyll::Hooks.register :posts, :post_init do |post|
 
-  commit_num = `git rev-list --count HEAD "#{ post.path }"`
+  commit_num, lastmod_date = Jekyll::PostsLastmod.lookup(post.path)
 
   if commit_num.to_i > 1
-    lastmod_date = `git log -1 --pretty="%ad" --date=iso "#{ post.path }"`
     post.data['last_modified_at'] = lastmod_date
   end
 
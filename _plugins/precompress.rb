@@ -0,0 +1,115 @@
+#!/usr/bin/env ruby
+#
+# Write precompressed siblings next to text assets
+#
+# After every other post-write step, each HTML, CSS, JS, SVG, JSON and XML
+# file in the output gets `.br`, `.zst` and `.gz` siblings at maximum
+# compression, so static servers (`gzip_static`, `brotli_static`) can
+# serve them without compressing per request. Jekyll's cleaner removes
+# files it did not write, so compressed files are kept in the cache dir by
+# content digest and linked into place; only new content is compressed,
+# in parallel across cores.
+
+require 'digest'
+require 'etc'
+require 'set'
+
+module Jekyll
+  module Precompress
+    DEFAULTS = {
+      'enabled'    => true,
+      'extensions' => %w(html css js svg json xml txt webmanifest),
+      'min_size'   => 256,
+      'workers'    => nil,
+      'formats'    => {
+        'br'  => 'brotli --best --stdout',
+        'zst' => 'zstd --ultra -22 -q --stdout',
+        'gz'  => 'gzip -9 -n --stdout'
+      }
+    }.freeze
+
+    class << self
+      def config(site)
+        config = DEFAULTS.merge(site.config['precompress'] || {})
+        config['formats'] = config['formats'].compact
+        config
+      end
+
+      def run(site)
+        config = config(site)
+        return unless config['enabled']
+
+        pattern = "**/*.{#{ config['extensions'].join(',') }}"
+        files = Dir.glob(pattern, base: site.dest).map { |rel| File.join(site.dest, rel) }
+                   .select { |file| File.file?(file) && File.size(file) >= config['min_size'].to_i }
+
+        links = []
+        jobs = {}
+        files.each do |file|
+          digest = Digest::SHA256.file(file).hexdigest
+
+          config['formats'].each do |ext, command|
+            cached = site.in_cache_dir('precompress', digest[0, 2], "#{ digest }.#{ ext }")
+            jobs[cached] ||= [file, cached, command.split] unless File.file?(cached)
+            links << [file, cached, ext]
+          end
+        end
+
+        # Identical files share a cached path and are compressed once.
+        compress(jobs.values, (config['workers'] || Etc.nprocessors).to_i)
+
+        links.each do |file, cached, ext|
+          sibling = "#{ file }.#{ ext }"
+          FileUtils.rm_f(sibling)
+          next unless File.file?(cached) && File.size(cached) < File.size(file)
+
+          begin
+            File.link(cached, sibling)
+          rescue SystemCallError
+            FileUtils.cp(cached, sibling)
+          end
+        end
+      end
+
+      private
+
+      def compress(jobs, workers)
+        return if jobs.empty?
+
+        Jekyll.logger.info 'Precompress:', "Compressing #{ jobs.size } file(s) with #{ workers } worker(s)"
+        running = {}
+        missing = Set.new
+
+        # Only the compressors are waited for, the first that has exited or
+        # else the oldest, as in responsive-images.rb.
+        reap = lambda do
+          pid, status = running.each_key.lazy.filter_map { |p| Process.wait2(p, Process::WNOHANG) }.first
+          pid, status = Process.wait2(running.each_key.first) if pid.nil?
+          partial, target = running.delete(pid)
+          status.success? ? File.rename(partial, target) : FileUtils.rm_f(partial)
+        end
+
+        jobs.each_with_index do |(source, target, command), index|
+          next if missing.include?(command.first)
+
+          reap.call while running.size >= workers
+
+          FileUtils.mkdir_p(File.dirname(target))
+          partial = "#{ target }.#{ Process.pid }-#{ index }.tmp"
+          pid = Process.spawn(*command, in: source, out: partial, err: File::NULL)
+          running[pid] = [partial, target]
+        rescue SystemCallError => e
+          FileUtils.rm_f(partial)
+          missing << command.first
+          Jekyll.logger.warn 'Precompress:', "Skipping .#{ File.extname(target).delete('.') } files, #{ e.message }"
+        end
+
+        reap.call until running.empty?
+      end
+    end
+  end
+end
+
+Jekyll::Hooks.register :site, :post_write, priority: :low do |site|
+  Jekyll::Precompress.run(site)
+end
@@ -0,0 +1,236 @@
+#!/usr/bin/env ruby
+#
+# Render math and Mermaid diagrams at build time
+#
+# In documents with `math: true` or `mermaid: true`, the TeX kramdown
+# leaves for MathJax (`\(...\)`, `\[...\]`, `$$...$$`) is rendered with
+# KaTeX and the ```` ```mermaid ```` blocks are rendered to SVG, right
+# after conversion. The work goes to a pool of long-lived node workers
+# (`tools/prerender/worker.js`, install its packages with
+# `npm install --prefix tools/prerender`), and every result is kept in a
+# Jekyll::Cache keyed by the digest of the expression. When everything in
+# a document was rendered, its `math` / `mermaid` flag is cleared so the
+# theme does not load MathJax or Mermaid for it; otherwise the client-side
+# libraries still handle what is left.
+
+require 'cgi'
+require 'etc'
+require 'json'
+require 'open3'
+require_relative 'cpp-snippets'
+
+module Jekyll
+  module Prerender
+    DEFAULTS = {
+      'enabled'    => true,
+      'node'       => 'node',
+      'worker'     => 'tools/prerender/worker.js',
+      'workers'    => nil,
+      'timeout'    => 60,
+      'math'       => true,
+      'mermaid'    => true,
+      'output'     => 'mathml', # KaTeX output, 'htmlAndMathml' also needs `stylesheet`
+      'stylesheet' => nil
+    }.freeze
+
+    # Elements whose text is never math.
+    VERBATIM = %r{(<(?:pre|code|script|style|textarea)\b.*?</(?:pre|code|script|style|textarea)>)}im.freeze
+    MATH = /\\\((?<inline>.+?)\\\)|\\\[(?<display>.+?)\\\]|\$\$(?<display2>.+?)\$\$/m.freeze
+    # kramdown has no Rouge lexer for Mermaid, so the blocks stay plain.
+    MERMAID = %r{<pre><code class="language-mermaid">(.*?)</code></pre>}m.freeze
+
+    class WorkerError < StandardError; end
+
+    class Worker
+      def initialize(config, source)
+        env = { 'PRERENDER_MATH_OUTPUT' => config['output'] }
+        @stdin, @stdout, @thread = Open3.popen2(env, config['node'], File.join(source, config['worker']))
+        @timeout = config['timeout'].to_i
+        @next = 0
+      end
+
+      # Replies to earlier jobs that timed out are skipped by their id.
+      def call(kind, source, display)
+        id = (@next += 1)
+        @stdin.puts(JSON.generate('id' => id, 'kind' => kind, 'source' => source, 'display' => display))
+        @stdin.flush
+
+        loop do
+          raise WorkerError, 'render worker timed out' unless IO.select([@stdout], nil, nil, @timeout)
+
+          line = @stdout.gets or raise WorkerError, 'render worker exited'
+          reply = JSON.parse(line)
+          next unless reply['id'] == id
+          raise WorkerError, reply['error'] if reply['error']
+
+          return reply['html']
+        end
+      rescue Errno::EPIPE, IOError
+        raise WorkerError, 'render worker exited'
+      end
+
+      def close
+        @stdin.close unless @stdin.closed?
+        @thread.join(5)
+      end
+    end
+
+    class << self
+      def config(site)
+        DEFAULTS.merge(site.config['prerender'] || {})
+      end
+
+      def cache
+        @cache ||= Jekyll::Cache.new('Jekyll::Prerender')
+      end
+
+      def render(doc)
+        config = config(doc.site)
+        math = config['math'] && doc.data['math']
+        mermaid = config['mermaid'] && doc.data['mermaid']
+        return unless config['enabled'] && (math || mermaid)
+
+        html = doc.content.to_s
+        jobs = {}
+        each_math(html) { |tex, display| jobs[job_key('tex', tex, display)] = ['tex', tex, display] } if math
+        if mermaid
+          html.scan(MERMAID) do
+            source = diagram(Regexp.last_match(1))
+            jobs[job_key('mermaid', source, true)] = ['mermaid', source, true]
+          end
+        end
+        return if jobs.empty?
+
+        run(doc.site, config, jobs.reject { |key, _| cache.key?(key) })
+
+        # A flag is only cleared when its kind was found and all of it was
+        # replaced, so the theme still loads the library for anything left.
+        if math
+          found = kept = 0
+          html = replace_math(html) do |tex, display, original|
+            key = job_key('tex', tex, display)
+            found += 1
+            next cache[key] if cache.key?(key)
+
+            kept += 1
+            original
+          end
+          if found > kept
+            doc.data['katex_stylesheet'] = config['stylesheet'] if config['stylesheet']
+            doc.data['math'] = false if kept.zero?
+          end
+        end
+
+        if mermaid
+          found = kept = 0
+          html = html.gsub(MERMAID) do |block|
+            key = job_key('mermaid', diagram(Regexp.last_match(1)), true)
+            found += 1
+            next %(<div class="mermaid-svg">#{ cache[key] }</div>) if cache.key?(key)
+
+            kept += 1
+            block
+          end
+          doc.data['mermaid'] = false if found.positive? && kept.zero?
+        end
+
+        doc.content = html
+      end
+
+      # The KaTeX stylesheet into the <head> of a page using rendered math.
+      def stylesheet(doc)
+        href = doc.data['katex_stylesheet']
+        return if href.nil? || doc.output.nil? || doc.output.include?(%(href="#{ href }"))
+
+        doc.output = doc.output.sub(%r{</head>}i) { %(<link rel="stylesheet" href="#{ href }">\n</head>) }
+      end
+
+      private
+
+      def job_key(kind, source, display)
+        Snippets.digest(kind, source, display)
+      end
+
+      # The TeX of each math span outside verbatim elements, unescaped.
+      def each_math(html)
+        replace_math(html) do |tex, display, original|
+          yield tex, display
+          original
+        end
+      end
+
+      def replace_math(html)
+        pieces = html.split(VERBATIM)
+        pieces.each_with_index.map do |piece, i|
+          next piece if i.odd?
+
+          piece.gsub(MATH) do |original|
+            match = Regexp.last_match
+            tex = match[:inline] || match[:display] || match[:display2]
+            yield CGI.unescapeHTML(tex.strip), match[:inline].nil?, original
+          end
+        end.join
+      end
+
+      def diagram(code)
+        CGI.unescapeHTML(code)
+      end
+
+      def run(site, config, jobs)
+        return if jobs.empty?
+
+        workers = pool(site, config, jobs.size)
+        return if workers.nil?
+
+        idle = Queue.new
+        workers.each { |worker| idle << worker }
+        lock = Mutex.new
+
+        Snippets.parallel(jobs.to_a, workers.size) do |key, (kind, source, display)|
+          worker = idle.pop
+          begin
+            html = worker.call(kind, source, display)
+            lock.synchronize { cache[key] = html }
+          rescue WorkerError, JSON::ParserError => e
+            Jekyll.logger.warn 'Prerender:', "Could not render #{ kind } (#{ e.message.lines.first&.strip })"
+          ensure
+            idle << worker
+          end
+        end
+      end
+
+      # Workers live for the whole process (also across `jekyll serve`
+      # rebuilds); a forked render worker starts its own.
+      def pool(site, config, jobs)
+        @workers = nil if @pid != Process.pid
+        @pid = Process.pid
+        return @workers if @workers && @workers.size >= [jobs, size(config)].min
+
+        script = File.join(site.source, config['worker'])
+        unless File.file?(script) && system(config['node'], '--version', out: File::NULL, err: File::NULL)
+          Jekyll.logger.warn 'Prerender:', "#{ config['node'] } or #{ config['worker'] } is missing, leaving math and diagrams to the browser" unless @warned
+          @warned = true
+          return
+        end
+
+        @workers ||= []
+        @workers << Worker.new(config, site.source) while @workers.size < [jobs, size(config)].min
+        @workers
+      end
+
+      def size(config)
+        (config['workers'] || [Etc.nprocessors, 4].min).to_i
+      end
+    end
+
+    at_exit { Array(@workers).each(&:close) if @pid == Process.pid }
+  end
+end
+
+Jekyll::Hooks.register :documents, :post_convert do |doc|
+  Jekyll::Prerender.render(doc)
+end
+
+Jekyll::Hooks.register :documents, :post_render do |doc|
+  Jekyll::Prerender.stylesheet(doc)
+end
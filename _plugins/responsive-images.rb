@@ -0,0 +1,235 @@
+#!/usr/bin/env ruby
+#
+# Generate AVIF/WebP variants for images and serve them through <picture>
+#
+# Every image matched by `responsive_images.source` is encoded once per
+# width bucket and format into `.jekyll-cache/responsive-images`, named
+# after the digest of its source. Inputs whose digest is unchanged since
+# the last build are not re-encoded. After rendering, `<img>` tags that
+# point at a processed image are wrapped in a `<picture>` with `srcset`
+# and intrinsic `width`/`height`.
+
+require 'digest'
+require 'etc'
+require 'json'
+
+module Jekyll
+  module ResponsiveImages
+    DEFAULTS = {
+      'enabled' => false,
+      'source'  => 'assets/img/*.{png,jpg,jpeg}',
+      'output'  => 'assets/img/variants',
+      'widths'  => [480, 960, 1600],
+      'formats' => %w(avif webp),
+      'quality' => 60,
+      'sizes'   => '100vw',
+      'command' => 'magick',
+      'workers' => nil
+    }.freeze
+
+    MIME_TYPES = { 'avif' => 'image/avif', 'webp' => 'image/webp' }.freeze
+
+    class << self
+      # url of the original image => { 'width', 'height', 'variants' }
+      attr_reader :images
+
+      def config(site)
+        DEFAULTS.merge(site.config['responsive_images'] || {})
+      end
+
+      def enabled?(site)
+        config(site)['enabled'] == true
+      end
+
+      def reset
+        @images = {}
+      end
+    end
+
+    class Generator < Jekyll::Generator
+      safe true
+      priority :low
+
+      def generate(site)
+        ResponsiveImages.reset
+        return unless ResponsiveImages.enabled?(site)
+
+        @site = site
+        @config = ResponsiveImages.config(site)
+        @base = site.in_cache_dir('responsive-images')
+        @manifest_file = site.in_cache_dir('responsive-images.json')
+
+        manifest = load_manifest
+        jobs = []
+
+        Dir.glob(@config['source'], base: site.source).sort.each do |rel|
+          src = site.in_source_dir(rel)
+          digest = Digest::SHA256.file(src).hexdigest
+          entry = manifest[rel]
+
+          unless entry && entry['digest'] == digest && entry['variants'].all? { |v| File.file?(variant_path(v)) }
+            entry = plan(src, digest)
+            next if entry.nil?
+
+            entry['variants'].each { |v| jobs << [v, encode_command(src, v)] }
+            manifest[rel] = entry
+          end
+
+          ResponsiveImages.images["/#{ rel }"] = entry
+        end
+
+        failed = run(jobs)
+        failed.each { |v| manifest.delete_if { |_, e| e['variants'].include?(v) } }
+        ResponsiveImages.images.delete_if { |_, e| (e['variants'] & failed).any? }
+        save_manifest(manifest)
+
+        ResponsiveImages.images.each_value do |entry|
+          entry['variants'].each do |v|
+            site.static_files << StaticFile.new(site, @base, @config['output'], v['file'])
+          end
+        end
+      end
+
+      private
+
+      def load_manifest
+        return {} unless File.file?(@manifest_file)
+
+        JSON.parse(File.read(@manifest_file))
+      rescue JSON::ParserError
+        {}
+      end
+
+      def save_manifest(manifest)
+        return if @site.config['disable_disk_cache']
+
+        FileUtils.mkdir_p(File.dirname(@manifest_file))
+        File.write(@manifest_file, JSON.generate(manifest))
+      end
+
+      def plan(src, digest)
+        width, height = `#{ @config['command'] } -ping "#{ src }" -format "%w %h" info:`.split.map(&:to_i)
+        if width.to_i.zero? || height.to_i.zero?
+          Jekyll.logger.warn 'Responsive images:', "Could not read the size of #{ src }"
+          return
+        end
+
+        widths = @config['widths'].select { |w| w < width }
+        widths << [width, @config['widths'].max].min
+        stem = File.basename(src, '.*')
+
+        variants = widths.uniq.product(@config['formats']).map do |w, format|
+          { 'file' => "#{ stem }-#{ w }.#{ digest[0, 8] }.#{ format }", 'width' => w, 'format' => format }
+        end
+
+        { 'digest' => digest, 'width' => width, 'height' => height, 'variants' => variants }
+      end
+
+      def variant_path(variant)
+        File.join(@base, @config['output'], variant['file'])
+      end
+
+      def encode_command(src, variant)
+        [*@config['command'].split, src, '-strip', '-resize', "#{ variant['width'] }x",
+         '-quality', @config['quality'].to_s, variant_path(variant)]
+      end
+
+      # Encodes in up to `workers` concurrent processes and returns the
+      # variants that failed.
+      def run(jobs)
+        return [] if jobs.empty?
+
+        FileUtils.mkdir_p(File.join(@base, @config['output']))
+        workers = (@config['workers'] || Etc.nprocessors).to_i
+        running = {}
+        failed = []
+
+        Jekyll.logger.info 'Responsive images:', "Encoding #{ jobs.size } variant(s) with #{ workers } worker(s)"
+
+        # Only the encoders are waited for, not other children of Jekyll:
+        # the first that has exited, or else the oldest.
+        reap = lambda do
+          pid, status = running.each_key.lazy.filter_map { |p| Process.wait2(p, Process::WNOHANG) }.first
+          pid, status = Process.wait2(running.each_key.first) if pid.nil?
+          variant = running.delete(pid)
+          failed << variant unless status.success?
+        end
+
+        jobs.each do |variant, cmd|
+          reap.call while running.size >= workers
+          running[Process.spawn(*cmd, out: File::NULL)] = variant
+        end
+        reap.call until running.empty?
+
+        failed.each do |v|
+          Jekyll.logger.warn 'Responsive images:', "Failed to encode #{ v['file'] }"
+          FileUtils.rm_f(variant_path(v))
+        end
+      end
+    end
+
+    module Rewriter
+      IMG_TAG = %r{<img\b[^>]*>}i.freeze
+      PICTURE = %r{<picture\b.*?</picture>}im.freeze
+
+      class << self
+        def rewrite(doc)
+          return if ResponsiveImages.images.nil? || ResponsiveImages.images.empty?
+
+          site = doc.site
+          config = ResponsiveImages.config(site)
+          prefix = "#{ site.config['img_cdn'] }#{ site.baseurl }"
+          url_base = "#{ site.baseurl }/#{ config['output'] }"
+
+          # Images already inside a <picture> are left alone.
+          doc.output = doc.output.split(%r{(#{ PICTURE })}im).map do |chunk|
+            next chunk if chunk.match?(%r{\A<picture\b}i)
+
+            chunk.gsub(IMG_TAG) do |tag|
+              src = tag[/\ssrc="([^"]+)"/, 1]
+              entry = src && ResponsiveImages.images[src.delete_prefix(prefix)]
+              next tag if entry.nil? || tag.include?('srcset=')
+
+              picture(tag, entry, url_base, config)
+            end
+          end.join
+        end
+
+        private
+
+        # Adds the missing one of `width` and `height` in the intrinsic
+        # aspect ratio, or both when neither is set.
+        def dimensions(tag, entry)
+          width = tag[/\swidth=["']?(\d+)["'\s>\/]/, 1]
+          height = tag[/\sheight=["']?(\d+)["'\s>\/]/, 1]
+          has_width = tag.match?(/\swidth=/)
+          has_height = tag.match?(/\sheight=/)
+          return tag if has_width && has_height
+
+          add =
+            if !has_width && !has_height
+              %( width="#{ entry['width'] }" height="#{ entry['height'] }")
+            elsif width
+              %( height="#{ (width.to_i * entry['height'] / entry['width'].to_f).round }")
+            elsif height
+              %( width="#{ (height.to_i * entry['width'] / entry['height'].to_f).round }")
+            end
+          add ? tag.sub(/\s*\/?>\z/) { |close| "#{ add }#{ close }" } : tag
+        end
+
+        def picture(tag, entry, url_base, config)
+          sources = entry['variants'].group_by { |v| v['format'] }.map do |format, variants|
+            srcset = variants.map { |v| "#{ url_base }/#{ v['file'] } #{ v['width'] }w" }.join(', ')
+            %(<source type="#{ MIME_TYPES.fetch(format, "image/#{ format }") }" srcset="#{ srcset }" sizes="#{ config['sizes'] }">)
+          end
+
+          "<picture>#{ sources.join }#{ dimensions(tag, entry) }</picture>"
+        end
+      end
+    end
+  end
+end
+
+Jekyll::Hooks.register [:pages, :documents], :post_render do |doc|
+  Jekyll::ResponsiveImages::Rewriter.rewrite(doc) if doc.output_ext == '.html'
+end
@@ -0,0 +1,97 @@
+#!/usr/bin/env ruby
+#
+# Cache Rouge highlighting across builds
+#
+# kramdown hands every fenced block to its Rouge highlighter, which lexes
+# it again on every build. The highlighter is wrapped so the generated
+# HTML is served from a Jekyll::Cache (persisted under `.jekyll-cache`)
+# keyed by language, highlighter options, code digest and Rouge version.
+#
+# Before rendering, fenced blocks that have not been seen yet are
+# highlighted in forked workers through the site's own Markdown
+# converter. Jekyll::Cache writes each entry to disk as it is stored, so
+# the parent picks the results up on its first lookup.
+
+require 'digest'
+require 'etc'
+require 'json'
+require 'kramdown'
+require 'kramdown/converter/syntax_highlighter/rouge'
+require 'rouge'
+
+module Jekyll
+  module RougeCache
+    DEFAULTS = {
+      'prewarm' => true,
+      'workers' => nil
+    }.freeze
+
+    FENCE = /^(?<fence>`{3,}|~{3,})[ \t]*(?<lang>[^\s`{]+)?[^\n]*\n(?<code>.*?)^\k<fence>[ \t]*$/m.freeze
+
+    class << self
+      def cache
+        @cache ||= Jekyll::Cache.new('Jekyll::RougeCache')
+      end
+
+      def fetch(converter, text, lang, type, call_opts)
+        key = JSON.generate([
+          lang, type, converter.options[:syntax_highlighter_opts].inspect, call_opts.inspect,
+          Digest::SHA256.hexdigest(text), ::Rouge.version, Kramdown::VERSION
+        ])
+
+        html, default_lang = cache.getset(key) do
+          [yield, call_opts[:default_lang]]
+        end
+
+        call_opts[:default_lang] = default_lang
+        html
+      end
+
+      def prewarm(site)
+        config = DEFAULTS.merge(site.config['rouge_cache'] || {})
+        return if !config['prewarm'] || site.config['disable_disk_cache'] || !Process.respond_to?(:fork)
+
+        blocks = site.documents.chain(site.pages)
+                     .select { |doc| doc.extname.to_s.match?(/\A\.(md|markdown)\z/i) && BuildShards.render?(doc) }
+                     .flat_map { |doc| doc.content.to_s.to_enum(:scan, FENCE).map { Regexp.last_match[0] } }
+                     .uniq.reject { |block| cache.key?(seen_key(block)) }
+        return if blocks.empty?
+
+        workers = [(config['workers'] || Etc.nprocessors).to_i, blocks.size].min
+        markdown = site.find_converter_instance(Jekyll::Converters::Markdown)
+
+        Jekyll.logger.info 'Rouge cache:', "Highlighting #{ blocks.size } block(s) with #{ workers } worker(s)"
+
+        pids = blocks.each_slice((blocks.size / workers.to_f).ceil).map do |slice|
+          fork do
+            slice.each do |block|
+              markdown.convert(block)
+              cache[seen_key(block)] = true
+            end
+            exit!(0)
+          end
+        end
+
+        pids.each { |pid| Process.wait(pid) }
+      end
+
+      private
+
+      def seen_key(block)
+        "seen:#{ Digest::SHA256.hexdigest(block) }"
+      end
+    end
+
+    module Highlighter
+      def call(converter, text, lang, type, call_opts)
+        RougeCache.fetch(converter, text, lang, type, call_opts) { super }
+      end
+    end
+
+    Kramdown::Converter::SyntaxHighlighter::Rouge.singleton_class.prepend Highlighter
+  end
+end
+
+Jekyll::Hooks.register :site, :pre_render do |site|
+  Jekyll::RougeCache.prewarm(site)
+end
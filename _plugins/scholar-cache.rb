@@ -0,0 +1,92 @@
+#!/usr/bin/env ruby
+#
+# Memoize jekyll-scholar
+#
+# Every `{% cite %}` and `{% bibliography %}` tag is a fresh Liquid tag
+# that parses the .bib files and runs CSL formatting again. Here the
+# bibliography is parsed once per build, and formatted citations and
+# bibliography entries are kept in a Jekyll::Cache (persisted under
+# `.jekyll-cache`) keyed by entry, style and locale. The cache is cleared
+# whenever the digest of the .bib files changes.
+
+require 'digest'
+require 'json'
+require 'jekyll/scholar'
+
+module Jekyll
+  class Scholar
+    module RenderCache
+      class << self
+        def reset
+          @bibliographies = {}
+          @digests = {}
+        end
+
+        def cache
+          @cache ||= Jekyll::Cache.new('Jekyll::Scholar::RenderCache')
+        end
+
+        def digest(paths)
+          @digests[paths] ||= begin
+            digest = Digest::SHA256.new
+            paths.each { |path| digest.file(path) }
+            digest.hexdigest
+          end
+        end
+
+        def bibliography(paths)
+          @bibliographies[paths] ||= yield
+        end
+
+        # Drops every cached fragment once the bibliography it was rendered
+        # from has changed.
+        def validate(digest)
+          return if @validated == digest
+
+          cache.clear if cache.key?('digest') && cache['digest'] != digest
+          cache['digest'] = digest
+          @validated = digest
+        end
+
+        def fetch(digest, *key, &block)
+          validate(digest)
+          cache.getset(JSON.generate([digest, Jekyll::Scholar::VERSION, *key]), &block)
+        end
+      end
+
+      def bibliography
+        RenderCache.bibliography(bibtex_paths) { super }
+      end
+
+      def render_citation(items)
+        # Keep the side effects `--cited` bibliographies rely on even when the
+        # formatted citation comes from the cache.
+        numbers = items.map do |entry|
+          cited_keys << entry.key
+          cited_keys.uniq!
+          citation_number(entry.key)
+        end
+
+        RenderCache.fetch(bib_digest, 'citation', items.map(&:key), numbers,
+                          locators, labels, style, config['locale']) { super }
+      end
+
+      def render_bibliography(entry, index = nil)
+        RenderCache.fetch(bib_digest, 'bibliography', entry.key.to_s, index,
+                          style, config['locale']) { super }
+      end
+
+      private
+
+      def bib_digest
+        RenderCache.digest(bibtex_paths)
+      end
+    end
+
+    Utilities.prepend RenderCache
+  end
+end
+
+Jekyll::Hooks.register :site, :after_reset do |_site|
+  Jekyll::Scholar::RenderCache.reset
+end
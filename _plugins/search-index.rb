@@ -0,0 +1,155 @@
+#!/usr/bin/env ruby
+#
+# Build a sharded binary search index
+#
+# Instead of one JSON holding every post's content, the search reads a
+# small `docs.json` with per-post metadata and, for each typed word, the
+# one shard holding the terms that start with its first two characters.
+# A shard is a sorted term list with varint-encoded posting lists:
+#
+#     shard   := varint(term_count) term*
+#     term    := varint(byte_length) utf8 varint(posting_count) posting*
+#     posting := varint(doc_id - previous_doc_id) varint(weight)
+#
+# Title matches weigh `title_weight` times more than body matches. The
+# files are written to `search.path` after the site is written. Each
+# post's entry is kept in a Jekyll::Cache keyed by the digest of its
+# source, so posts an incremental build did not render stay searchable.
+
+require 'cgi'
+require 'digest'
+require 'json'
+
+module Jekyll
+  module SearchIndex
+    DEFAULTS = {
+      'enabled'      => true,
+      'path'         => 'assets/js/data/search',
+      'title_weight' => 5,
+      'snippet'      => 200,
+      'min_length'   => 2
+    }.freeze
+
+    TERM = /[\p{L}\p{N}_][\p{L}\p{N}_+#]*/.freeze
+
+    class << self
+      def config(site)
+        DEFAULTS.merge(site.config['search'] || {})
+      end
+
+      def varint(int, out)
+        loop do
+          byte = int & 0x7f
+          int >>= 7
+          if int.zero?
+            out << byte
+            break
+          end
+          out << (byte | 0x80)
+        end
+        out
+      end
+
+      def shard_name(term)
+        term[0, 2].unpack1('H*')
+      end
+
+      def terms(text, min_length)
+        text.downcase.scan(TERM).select { |term| term.length >= min_length }
+      end
+
+      def text(html)
+        body = html[%r{<article\b.*?</article>}im] || html
+        CGI.unescapeHTML(body.gsub(%r{<(script|style)\b.*?</\1>}im, ' ').gsub(/<[^>]*>/, ' ')).gsub(/\s+/, ' ').strip
+      end
+
+      def cache
+        @cache ||= Jekyll::Cache.new('Jekyll::SearchIndex')
+      end
+
+      def build(site)
+        config = config(site)
+        return unless config['enabled']
+
+        docs = []
+        postings = Hash.new { |h, term| h[term] = Hash.new(0) }
+        missing = 0
+
+        site.posts.docs.reverse.each do |post|
+          next if post.data['search'] == false
+
+          entry = entry(post, config)
+          next missing += 1 if entry.nil?
+
+          id = docs.size
+          docs << entry['doc']
+          entry['weights'].each { |term, weight| postings[term][id] += weight }
+        end
+
+        Jekyll.logger.warn 'Search:', "#{ missing } post(s) were neither rendered nor cached, they are not indexed" if missing.positive?
+        write(site, config, docs, postings)
+      end
+
+      private
+
+      # The index entry of a post, from its output when it was rendered and
+      # from the cache otherwise.
+      def entry(post, config)
+        key = Digest::SHA256.hexdigest([post.relative_path, post.url, File.read(post.path),
+                                        config.inspect].join("\0"))
+        return (cache[key] if cache.key?(key)) if post.output.nil?
+
+        title = post.data['title'].to_s
+        body = text(post.output)
+        weights = Hash.new(0)
+        terms(title, config['min_length']).each { |term| weights[term] += config['title_weight'].to_i }
+        terms(body, config['min_length']).each { |term| weights[term] += 1 }
+
+        cache[key] = {
+          'doc'     => {
+            'title'      => title,
+            'url'        => post.url,
+            'date'       => post.date.strftime('%Y-%m-%d'),
+            'categories' => post.data['categories'] || [],
+            'tags'       => post.data['tags'] || [],
+            'snippet'    => body[0, config['snippet'].to_i]
+          },
+          'weights' => weights.to_h
+        }
+      end
+
+      def write(site, config, docs, postings)
+        dir = File.join(site.dest, config['path'])
+        FileUtils.rm_rf(dir)
+        FileUtils.mkdir_p(dir)
+
+        postings.keys.sort.group_by { |term| shard_name(term) }.each do |name, terms|
+          out = []
+          varint(terms.size, out)
+
+          terms.each do |term|
+            bytes = term.b
+            varint(bytes.bytesize, out)
+            out.concat(bytes.bytes)
+            varint(postings[term].size, out)
+
+            previous = 0
+            postings[term].sort.each do |id, weight|
+              varint(id - previous, out)
+              varint(weight, out)
+              previous = id
+            end
+          end
+
+          File.binwrite(File.join(dir, "#{ name }.bin"), out.pack('C*'))
+        end
+
+        File.write(File.join(dir, 'docs.json'), JSON.generate(docs))
+      end
+    end
+  end
+end
+
+Jekyll::Hooks.register :site, :post_write, priority: :high do |site|
+  Jekyll::SearchIndex.build(site)
+end
@@ -0,0 +1,81 @@
+#!/usr/bin/env ruby
+#
+# Write the service worker precache manifest
+#
+# After the site is written, every output asset is listed in
+# `sw-manifest.json` with a digest of its content, so the service worker
+# only downloads the entries whose revision changed. Files under
+# `pwa.cache.deny_paths` are left out, and files larger than
+# `pwa.cache.precache_max_size` are listed as runtime entries that are
+# cached on first use instead. The digest of the manifest is written into
+# the service worker script, which makes browsers pick up the new list.
+
+require 'digest'
+require 'json'
+
+module Jekyll
+  module SwPrecache
+    DEFAULTS = {
+      'precache_max_size'   => 1_048_576,
+      'precache_html'       => false,
+      'runtime_max_entries' => 20
+    }.freeze
+
+    MANIFEST = 'sw-manifest.json'
+    WORKER = 'sw.min.js'
+    PLACEHOLDER = '__PRECACHE_REVISION__'
+    SKIPPED = /\.(?:map|gz|br|zst)\z/.freeze
+
+    class << self
+      def config(site)
+        DEFAULTS.merge(site.config.dig('pwa', 'cache') || {})
+      end
+
+      def enabled?(site)
+        site.config.dig('pwa', 'enabled') && site.config.dig('pwa', 'cache', 'enabled')
+      end
+
+      def write(site)
+        return unless enabled?(site)
+
+        config = config(site)
+        deny = Array(config['deny_paths']).compact.map { |path| path.chomp('/') }
+        precache = []
+        runtime = []
+
+        Dir.glob('**/*', base: site.dest).sort.each do |rel|
+          file = File.join(site.dest, rel)
+          next unless File.file?(file)
+          next if [MANIFEST, WORKER].include?(rel) || rel.match?(SKIPPED)
+          next if rel.end_with?('.html') && !config['precache_html']
+
+          url = "#{ site.baseurl }/#{ rel.delete_suffix('index.html') }"
+          next if deny.any? { |path| url == path || url.start_with?("#{ path }/") }
+
+          if File.size(file) > config['precache_max_size'].to_i
+            runtime << url
+          else
+            precache << { 'url' => url, 'revision' => Digest::SHA256.file(file).hexdigest[0, 12] }
+          end
+        end
+
+        manifest = JSON.generate(
+          'precache' => precache,
+          'runtime'  => { 'urls' => runtime, 'max_entries' => config['runtime_max_entries'].to_i },
+          'deny'     => deny
+        )
+        File.write(File.join(site.dest, MANIFEST), manifest)
+
+        worker = File.join(site.dest, WORKER)
+        return unless File.file?(worker)
+
+        script = File.read(worker)
+        File.write(worker, script.gsub(PLACEHOLDER, Digest::SHA256.hexdigest(manifest)[0, 12])) if script.include?(PLACEHOLDER)
+      end
+    end
+  end
+end
+
+Jekyll::Hooks.register :site, :post_write do |site|
+  Jekyll::SwPrecache.write(site)
+end
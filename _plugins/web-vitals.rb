@@ -0,0 +1,43 @@
+#!/usr/bin/env ruby
+#
+# Map page paths to templates for the web vitals reports
+#
+# The beacon of `_includes/web-vitals.html` reports the path and layout of
+# a page. This writes `web_vitals.pages_file` into the site, mapping every
+# HTML path to its layout and, for collection documents, its ID, so the
+# reports can be grouped per template or per post when they are analysed.
+
+require 'json'
+
+module Jekyll
+  module WebVitals
+    DEFAULTS = {
+      'enabled'    => false,
+      'pages_file' => 'web-vitals-pages.json'
+    }.freeze
+
+    class << self
+      def config(site)
+        DEFAULTS.merge(site.config['web_vitals'] || {})
+      end
+
+      def write(site)
+        config = config(site)
+        return unless config['enabled']
+
+        items = site.pages + site.collections.each_value.flat_map(&:docs).select(&:write?)
+        pages = items.select { |item| item.output_ext == '.html' }.sort_by(&:url).to_h do |item|
+          entry = { 'layout' => item.data['layout'] }
+          entry['id'] = item.id if item.respond_to?(:id)
+          ["#{ site.baseurl }#{ item.url }", entry.compact]
+        end
+
+        File.write(site.in_dest_dir(config['pages_file']), JSON.generate(pages))
+      end
+    end
+  end
+end
+
+Jekyll::Hooks.register :site, :post_write, priority: :high do |site|
+  Jekyll::WebVitals.write(site)
+end
@@ -0,0 +1,198 @@
+#!/usr/bin/env ruby
+#
+# Resolve WG21 paper citations against the wg21.link index
+#
+# The index is downloaded once into `.jekyll-cache/wg21/index.tsv`, one
+# "KEY\ttitle\tauthor\tdate\tlink" line per paper sorted by key, and
+# looked up with a binary search over the file. Only papers that are
+# actually cited (`{% cite N2248 %}`, `{% cite P2996R4 %}`, or `P2996` for
+# the latest revision) and are not already in `_bibliography` are written
+# to a generated .bib file that jekyll-scholar reads alongside the others.
+
+require 'json'
+require 'net/http'
+require 'jekyll/scholar'
+
+module Jekyll
+  module WG21
+    DEFAULTS = {
+      'enabled'      => true,
+      'index'        => 'https://wg21.link/index.json',
+      'refresh_days' => 30
+    }.freeze
+
+    PAPER = /\A(?:N\d{4}|P\d{4}(?:R\d+)?)\z/i.freeze
+    CITE_TAG = /\{%-?\s*cite\s+([^%]*?)-?%\}/.freeze
+
+    class << self
+      attr_accessor :bib_file
+    end
+
+    # Binary search over a file of lines sorted by their first field.
+    class SortedIndex
+      def initialize(path)
+        @file = File.open(path, 'rb')
+        @size = @file.size
+      end
+
+      def close
+        @file.close
+      end
+
+      def [](key)
+        line = line_at(lower_bound(key))
+        fields(line) if line && fields(line).first == key
+      end
+
+      # The newest revision of a paper number, e.g. P2996 -> P2996R4.
+      def latest(number)
+        prefix = "#{ number }R"
+        @file.seek(start_of(lower_bound(prefix)))
+        best = nil
+
+        while (line = @file.gets)&.start_with?(prefix)
+          row = fields(line)
+          best = row if best.nil? || revision(row.first) > revision(best.first)
+        end
+
+        best
+      end
+
+      private
+
+      def fields(line)
+        line.chomp.split("\t", -1)
+      end
+
+      def revision(key)
+        key[/R(\d+)\z/, 1].to_i
+      end
+
+      # Offset of the first line starting at or after `pos`.
+      def start_of(pos)
+        return 0 if pos.zero?
+
+        @file.seek(pos - 1)
+        @file.gets
+        @file.pos
+      end
+
+      def line_at(pos)
+        @file.seek(start_of(pos))
+        @file.gets
+      end
+
+      def lower_bound(key)
+        lo = 0
+        hi = @size
+
+        while lo < hi
+          mid = (lo + hi) / 2
+          line = line_at(mid)
+
+          if line.nil? || fields(line).first >= key
+            hi = mid
+          else
+            lo = mid + 1
+          end
+        end
+
+        lo
+      end
+    end
+
+    class Generator < Jekyll::Generator
+      safe true
+      priority :high
+
+      def generate(site)
+        config = DEFAULTS.merge(site.config['wg21'] || {})
+        WG21.bib_file = nil
+        return unless config['enabled']
+
+        known = known(site)
+        keys = cited(site).reject { |key| known.include?(key.upcase) }
+        return if keys.empty?
+
+        index_file = site.in_cache_dir('wg21', 'index.tsv')
+        return unless fetch(index_file, config)
+
+        index = SortedIndex.new(index_file)
+        entries = keys.sort.filter_map do |key|
+          id = key.upcase
+          row = id.match?(/R\d+\z/) || id.start_with?('N') ? index[id] : index.latest(id)
+          Jekyll.logger.warn 'WG21:', "#{ key } is not in the wg21.link index" if row.nil?
+          row && bibtex(key, *row)
+        end
+        index.close
+
+        WG21.bib_file = site.in_cache_dir('wg21', 'papers.bib')
+        content = entries.join("\n")
+        File.write(WG21.bib_file, content) unless File.file?(WG21.bib_file) && File.read(WG21.bib_file) == content
+      end
+
+      private
+
+      def cited(site)
+        (site.documents + site.pages).flat_map { |doc| doc.content.to_s.scan(CITE_TAG) }
+                                      .flat_map { |(args)| args.split.take_while { |arg| !arg.start_with?('--') } }
+                                      .grep(PAPER).uniq
+      end
+
+      def known(site)
+        dir = site.config.dig('scholar', 'source') || './_bibliography'
+
+        Dir.glob(File.join(site.in_source_dir(dir), '*.bib')).flat_map do |file|
+          File.read(file).scan(/^@\w+\s*\{\s*([^,\s]+)\s*,/).flatten.map(&:upcase)
+        end
+      end
+
+      def fetch(index_file, config)
+        fresh = File.file?(index_file) &&
+                File.mtime(index_file) > Time.now - (config['refresh_days'].to_i * 86_400)
+        return true if fresh
+
+        Jekyll.logger.info 'WG21:', "Downloading #{ config['index'] }"
+        papers = JSON.parse(Net::HTTP.get(URI(config['index'])))
+
+        lines = papers.filter_map do |key, paper|
+          next unless paper.is_a?(Hash)
+
+          row = [key.upcase, *paper.values_at('title', 'author', 'date', 'link')]
+          "#{ row.map { |field| field.to_s.gsub(/\s+/, ' ').strip }.join("\t") }\n"
+        end
+
+        FileUtils.mkdir_p(File.dirname(index_file))
+        File.write(index_file, lines.sort.join)
+        true
+      rescue StandardError => e
+        Jekyll.logger.warn 'WG21:', "Could not fetch the paper index: #{ e.message }"
+        File.file?(index_file)
+      end
+
+      def bibtex(key, number, title, author, date, link)
+        year, month = date.split('-')
+        fields = {
+          'title'       => title,
+          'author'      => author.split(/\s*,\s*/).join(' and '),
+          'institution' => 'WG21',
+          'number'      => number,
+          'year'        => year,
+          'month'       => month&.to_i&.to_s,
+          'url'         => link.empty? ? "https://wg21.link/#{ number.downcase }" : link
+        }.reject { |_, value| value.nil? || value.empty? }
+
+        body = fields.map { |name, value| "  #{ name.ljust(11) } = {#{ value.delete('{}') }}" }
+        "@techreport{#{ key },\n#{ body.join(",\n") }\n}\n"
+      end
+    end
+
+    module Bibliography
+      def bibtex_paths
+        WG21.bib_file ? super + [WG21.bib_file] : super
+      end
+    end
+
+    Jekyll::Scholar::Utilities.prepend Bibliography
+  end
+end
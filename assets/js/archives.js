@@ -0,0 +1,104 @@
+/*
+ * Windowed archives list for `_layouts/archives.html`. Only the year groups
+ * near the viewport are in the DOM; the others are placeholders of their
+ * last measured (or estimated) height, and their chunk is fetched the first
+ * time they come close.
+ */
+(function () {
+  'use strict';
+
+  const root = document.getElementById('archives');
+  if (!root || !('IntersectionObserver' in window)) return;
+
+  const base = root.dataset.chunks;
+  const chunks = new Map();
+  let rowHeight = 32;
+
+  function chunk(year) {
+    if (!chunks.has(year)) {
+      chunks.set(
+        year,
+        fetch(`${base}/${year}.json`).then((r) => r.json())
+      );
+    }
+    return chunks.get(year);
+  }
+
+  function list(posts) {
+    const ul = document.createElement('ul');
+    ul.className = 'list-unstyled';
+
+    posts.forEach((post) => {
+      const li = document.createElement('li');
+      const day = document.createElement('span');
+      const month = document.createElement('span');
+      const link = document.createElement('a');
+
+      day.className = 'date day';
+      day.textContent = post.d;
+      month.className = 'date month small text-muted ms-1';
+      month.textContent = post.m;
+      link.href = `${root.dataset.baseurl || ''}${post.u}`;
+      link.textContent = post.t;
+
+      li.append(day, ' ', month, ' ', link);
+      ul.appendChild(li);
+    });
+    return ul;
+  }
+
+  function placeholder(height) {
+    const div = document.createElement('div');
+    div.className = 'archive-placeholder';
+    div.style.height = `${height}px`;
+    return div;
+  }
+
+  function show(section) {
+    if (section.dataset.state !== 'hidden') return;
+    section.dataset.state = 'loading';
+
+    chunk(section.dataset.year).then((data) => {
+      if (section.dataset.state !== 'loading') return;
+
+      const ul = list(data.posts);
+      section.lastChild.replaceWith(ul);
+      section.dataset.state = 'shown';
+      rowHeight = ul.offsetHeight / data.posts.length || rowHeight;
+    });
+  }
+
+  function hide(section) {
+    if (section.dataset.state === 'shown') {
+      section.lastChild.replaceWith(placeholder(section.lastChild.offsetHeight));
+    }
+    section.dataset.state = 'hidden';
+  }
+
+  const observer = new IntersectionObserver(
+    (entries) => entries.forEach((e) => (e.isIntersecting ? show(e.target) : hide(e.target))),
+    { rootMargin: '100% 0px' }
+  );
+
+  fetch(`${base}/index.json`)
+    .then((r) => r.json())
+    .then((index) => {
+      const sections = index.years.map(({ year, count }) => {
+        const section = document.createElement('section');
+        const time = document.createElement('time');
+
+        time.className = 'year lead d-block';
+        time.textContent = year;
+        section.dataset.year = year;
+        section.dataset.state = 'hidden';
+        section.append(time, placeholder(count * rowHeight));
+        return section;
+      });
+
+      root.replaceChildren(...sections);
+      sections.forEach((s) => observer.observe(s));
+    })
+    .catch(() => {
+      /* keep the static list */
+    });
+})();
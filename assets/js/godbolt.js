@@ -0,0 +1,23 @@
+/*
+ * Swaps a `{% godbolt %}` snapshot (see `_plugins/godbolt.rb`) for the live
+ * Compiler Explorer editor when its "Open in editor" button is clicked.
+ */
+(function () {
+  'use strict';
+
+  document.addEventListener('click', (e) => {
+    const button = e.target.closest && e.target.closest('.godbolt-open');
+    if (!button || e.ctrlKey || e.metaKey || e.shiftKey) return;
+
+    e.preventDefault();
+    const pane = button.closest('.godbolt');
+    const iframe = document.createElement('iframe');
+
+    iframe.src = button.href;
+    iframe.title = 'Compiler Explorer';
+    iframe.className = 'godbolt-frame w-100 border rounded';
+    iframe.style.height = `${Math.max(pane.offsetHeight, 480)}px`;
+    iframe.setAttribute('allow', 'clipboard-write');
+    pane.replaceWith(iframe);
+  });
+})();
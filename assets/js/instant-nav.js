@@ -0,0 +1,89 @@
+/*
+ * Fallback link prefetching for browsers without the Speculation Rules API,
+ * see `_includes/instant-navigation.html`. Links matching the configured
+ * patterns are prefetched on hover, touchstart or when they scroll into
+ * view, a few at a time and never on Save-Data or 2G connections.
+ */
+(function () {
+  'use strict';
+
+  if (HTMLScriptElement.supports && HTMLScriptElement.supports('speculationrules')) {
+    return;
+  }
+
+  const script = document.currentScript;
+  const connection = navigator.connection || {};
+  if (connection.saveData || /2g/.test(connection.effectiveType || '')) {
+    return;
+  }
+
+  const baseurl = script.dataset.baseurl;
+  const trigger = script.dataset.trigger;
+  const concurrency = Number(script.dataset.concurrency);
+  const max = Number(script.dataset.max);
+
+  /* `/posts/*` style patterns, as in the speculation rules */
+  const patterns = script.dataset.patterns
+    .split(' ')
+    .filter(Boolean)
+    .map((p) => new RegExp(`^${(baseurl + p).replace(/[.+?^${}()|[\]\\]/g, '\\$&').replace(/\*/g, '.*')}$`));
+
+  const done = new Set([location.pathname]);
+  const queue = [];
+  let active = 0;
+
+  function eligible(a) {
+    if (!a.href || a.hasAttribute('data-no-prefetch') || /\bnofollow\b/.test(a.rel)) return null;
+
+    const url = new URL(a.href, location.href);
+    if (url.origin !== location.origin || done.has(url.pathname)) return null;
+    return patterns.some((re) => re.test(url.pathname)) ? url : null;
+  }
+
+  function pump() {
+    while (active < concurrency && queue.length && done.size <= max) {
+      const url = queue.shift();
+      active++;
+
+      const link = document.createElement('link');
+      link.rel = 'prefetch';
+      link.href = url.href;
+      link.onload = link.onerror = () => {
+        active--;
+        pump();
+      };
+      document.head.appendChild(link);
+    }
+  }
+
+  function prefetch(a) {
+    const url = eligible(a);
+    if (!url) return;
+
+    done.add(url.pathname);
+    queue.push(url);
+    pump();
+  }
+
+  const onPointer = (e) => {
+    const a = e.target.closest && e.target.closest('a[href]');
+    if (a) prefetch(a);
+  };
+
+  document.addEventListener('mouseover', onPointer, { passive: true });
+  document.addEventListener('touchstart', onPointer, { passive: true });
+
+  if (trigger === 'viewport' && 'IntersectionObserver' in window) {
+    const observer = new IntersectionObserver((entries) => {
+      entries.forEach((e) => {
+        if (e.isIntersecting) {
+          observer.unobserve(e.target);
+          prefetch(e.target);
+        }
+      });
+    });
+
+    const observe = () => document.querySelectorAll('a[href]').forEach((a) => eligible(a) && observer.observe(a));
+    (window.requestIdleCallback || setTimeout)(observe);
+  }
+})();
@@ -0,0 +1,139 @@
+---
+permalink: '/:basename.min.js'
+# Overrides the theme's service worker. It is published to the root of the site,
+# hence `:basename`; the revision below is filled in by `_plugins/sw-precache.rb`.
+---
+
+const revision = '__PRECACHE_REVISION__';
+const baseurl = '{{ site.baseurl }}';
+const precacheName = 'precache';
+const runtimeName = 'runtime';
+const manifestKey = `${baseurl}/__sw-manifest__`;
+
+async function loadManifest() {
+  const response = await fetch(`${baseurl}/sw-manifest.json?${revision}`, { cache: 'no-store' });
+  return response.json();
+}
+
+/* Downloads only the entries whose revision differs from the stored list. */
+async function syncPrecache(manifest) {
+  const cache = await caches.open(precacheName);
+  const stored = await cache.match(manifestKey);
+  const previous = stored ? await stored.json() : { precache: [] };
+
+  const known = new Map(previous.precache.map((e) => [e.url, e.revision]));
+  const current = new Map(manifest.precache.map((e) => [e.url, e.revision]));
+
+  const changed = manifest.precache.filter((e) => known.get(e.url) !== e.revision);
+  await Promise.all(
+    changed.map(async (e) => {
+      const response = await fetch(`${e.url}?${e.revision}`, { cache: 'no-cache' });
+      if (response.ok) {
+        await cache.put(e.url, response);
+      }
+    })
+  );
+
+  await Promise.all(
+    [...known.keys()].filter((url) => !current.has(url)).map((url) => cache.delete(url))
+  );
+
+  await cache.put(manifestKey, new Response(JSON.stringify(manifest)));
+}
+
+let manifestPromise = null;
+
+function manifest() {
+  if (!manifestPromise) {
+    manifestPromise = caches
+      .open(precacheName)
+      .then((cache) => cache.match(manifestKey))
+      .then((r) => (r ? r.json() : loadManifest()));
+  }
+  return manifestPromise;
+}
+
+/* Cache-first for large media, keeping at most `max_entries` of them. */
+async function fromRuntime(request, maxEntries) {
+  const cache = await caches.open(runtimeName);
+  const cached = await cache.match(request);
+  if (cached) {
+    return cached;
+  }
+
+  const response = await fetch(request);
+  if (response.ok) {
+    await cache.put(request, response.clone());
+    const keys = await cache.keys();
+    await Promise.all(keys.slice(0, Math.max(0, keys.length - maxEntries)).map((k) => cache.delete(k)));
+  }
+  return response;
+}
+
+/* Network-first for pages, so readers see new posts, with the cache as offline fallback. */
+async function fromNetwork(request) {
+  const cache = await caches.open(runtimeName);
+  try {
+    const response = await fetch(request);
+    if (response.ok) {
+      await cache.put(request, response.clone());
+    }
+    return response;
+  } catch (err) {
+    const cached = await cache.match(request);
+    if (cached) {
+      return cached;
+    }
+    throw err;
+  }
+}
+
+self.addEventListener('install', (event) => {
+  event.waitUntil(
+    loadManifest()
+      .then(syncPrecache)
+      .then(() => self.skipWaiting())
+  );
+});
+
+self.addEventListener('activate', (event) => {
+  manifestPromise = null;
+  event.waitUntil(
+    caches
+      .keys()
+      .then((names) =>
+        Promise.all(names.filter((n) => n !== precacheName && n !== runtimeName).map((n) => caches.delete(n)))
+      )
+      .then(() => self.clients.claim())
+  );
+});
+
+self.addEventListener('fetch', (event) => {
+  const request = event.request;
+  const url = new URL(request.url);
+
+  if (request.method !== 'GET' || url.origin !== self.location.origin) {
+    return;
+  }
+
+  event.respondWith(
+    manifest().then(async (m) => {
+      const path = url.pathname;
+
+      if (m.deny.some((p) => path === p || path.startsWith(`${p}/`))) {
+        return fetch(request);
+      }
+
+      const precached = await caches.open(precacheName).then((c) => c.match(path));
+      if (precached) {
+        return precached;
+      }
+
+      if (m.runtime.urls.includes(path)) {
+        return fromRuntime(request, m.runtime.max_entries);
+      }
+
+      return request.mode === 'navigate' ? fromNetwork(request) : fetch(request);
+    })
+  );
+});
@@ -0,0 +1,119 @@
+/*
+ * Client for the sharded search index written by `_plugins/search-index.rb`.
+ * Only `docs.json` and the shards for the typed words are fetched.
+ */
+(function () {
+  'use strict';
+
+  function hex(term) {
+    const prefix = Array.from(term).slice(0, 2).join('');
+    return Array.from(new TextEncoder().encode(prefix), (b) => b.toString(16).padStart(2, '0')).join('');
+  }
+
+  /* Decodes a shard into `term => Map(docId => weight)`. */
+  function decode(buffer) {
+    const bytes = new Uint8Array(buffer);
+    const decoder = new TextDecoder();
+    let pos = 0;
+
+    function varint() {
+      let result = 0;
+      let shift = 0;
+      let byte;
+      do {
+        byte = bytes[pos++];
+        result += (byte & 0x7f) * Math.pow(2, shift);
+        shift += 7;
+      } while (byte & 0x80);
+      return result;
+    }
+
+    const terms = new Map();
+    const count = varint();
+    for (let i = 0; i < count; i++) {
+      const length = varint();
+      const term = decoder.decode(bytes.subarray(pos, pos + length));
+      pos += length;
+
+      const postings = new Map();
+      const size = varint();
+      let id = 0;
+      for (let j = 0; j < size; j++) {
+        id += varint();
+        postings.set(id, varint());
+      }
+      terms.set(term, postings);
+    }
+    return terms;
+  }
+
+  class ShardedSearch {
+    constructor(options) {
+      this.base = options.base;
+      this.minLength = options.minLength;
+      this.limit = options.limit;
+      this.shards = new Map();
+      this.docs = null;
+    }
+
+    documents() {
+      if (!this.docs) {
+        this.docs = fetch(`${this.base}/docs.json`).then((r) => r.json());
+      }
+      return this.docs;
+    }
+
+    shard(term) {
+      const name = hex(term);
+      if (!this.shards.has(name)) {
+        this.shards.set(
+          name,
+          fetch(`${this.base}/${name}.bin`)
+            .then((r) => (r.ok ? r.arrayBuffer().then(decode) : new Map()))
+            .catch(() => new Map())
+        );
+      }
+      return this.shards.get(name);
+    }
+
+    /* Every word must match; the last one is matched as a prefix while typing. */
+    async search(query) {
+      const words = query.toLowerCase().match(/[\p{L}\p{N}_][\p{L}\p{N}_+#]*/gu) || [];
+      const terms = words.filter((w) => w.length >= this.minLength);
+      if (terms.length === 0) {
+        return [];
+      }
+
+      const [docs, ...shards] = await Promise.all([this.documents(), ...terms.map((t) => this.shard(t))]);
+      let scores = null;
+
+      terms.forEach((term, i) => {
+        const matches = new Map();
+        const prefix = i === terms.length - 1;
+
+        shards[i].forEach((postings, candidate) => {
+          if (candidate === term || (prefix && candidate.startsWith(term))) {
+            postings.forEach((weight, id) => matches.set(id, (matches.get(id) || 0) + weight));
+          }
+        });
+
+        if (scores === null) {
+          scores = matches;
+        } else {
+          const next = new Map();
+          scores.forEach((weight, id) => {
+            if (matches.has(id)) next.set(id, weight + matches.get(id));
+          });
+          scores = next;
+        }
+      });
+
+      return [...scores.entries()]
+        .sort((a, b) => b[1] - a[1] || a[0] - b[0])
+        .slice(0, this.limit)
+        .map(([id]) => docs[id]);
+    }
+  }
+
+  window.ShardedSearch = ShardedSearch;
+})();
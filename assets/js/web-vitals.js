@@ -0,0 +1,69 @@
+/*
+ * Field Core Web Vitals beacon, see `_includes/web-vitals.html`. Collects
+ * LCP, INP, CLS and TTFB, rounds them into coarse buckets and sends them
+ * once, the first time the page is hidden. No identifiers are sent, so a
+ * later report could not replace that one; shifts and interactions after
+ * the reader comes back to the tab are not counted.
+ */
+(function () {
+  'use strict';
+
+  const s = document.currentScript.dataset;
+  if (Math.random() >= Number(s.sample)) return;
+
+  const v = {};
+  const observe = (type, cb, opts) => {
+    try {
+      new PerformanceObserver((l) => l.getEntries().forEach(cb)).observe(Object.assign({ type, buffered: true }, opts));
+    } catch (e) {
+      /* unsupported entry type */
+    }
+  };
+
+  const nav = performance.getEntriesByType('navigation')[0];
+  if (nav) v.TTFB = Math.max(nav.responseStart - (nav.activationStart || 0), 0);
+
+  observe('largest-contentful-paint', (e) => (v.LCP = e.startTime));
+
+  /* CLS: the largest session window of shifts (gap < 1 s, span < 5 s). */
+  let session = 0, first = 0, last = 0;
+  observe('layout-shift', (e) => {
+    if (e.hadRecentInput) return;
+    session = e.startTime - last < 1000 && e.startTime - first < 5000 ? session + e.value : ((first = e.startTime), e.value);
+    last = e.startTime;
+    v.CLS = Math.max(v.CLS || 0, session);
+  });
+
+  /* INP: the slowest interaction, ignoring one outlier per 50 interactions. */
+  const slowest = new Map();
+  observe('event', (e) => {
+    if (!e.interactionId) return;
+    slowest.set(e.interactionId, Math.max(slowest.get(e.interactionId) || 0, e.duration));
+    const d = [...slowest.values()].sort((a, b) => b - a);
+    v.INP = d[Math.min(d.length - 1, Math.floor(d.length / 50))];
+  }, { durationThreshold: 40 });
+
+  const bucket = (m, x) => (m === 'CLS' ? Math.round(x * 20) / 20 : Math.round(x / (m === 'INP' ? 50 : 250)) * (m === 'INP' ? 50 : 250));
+
+  let sent = false;
+  addEventListener('visibilitychange', () => {
+    if (document.visibilityState !== 'hidden' || sent) return;
+    sent = true;
+
+    const c = navigator.connection;
+    const conn = (c && c.effectiveType) || 'unknown';
+    const metrics = Object.keys(v).map((m) => [m, bucket(m, v[m])]);
+    if (!metrics.length) return;
+
+    if (s.format === 'goatcounter') {
+      metrics.forEach(([m, x]) => {
+        const p = `vitals/${m}/${s.type}/${conn}/${x}`;
+        navigator.sendBeacon(`${s.endpoint}?p=${encodeURIComponent(p)}&e=true&t=${encodeURIComponent(location.pathname)}`);
+      });
+    } else {
+      const body = { path: location.pathname, type: s.type, connection: conn, metrics: Object.fromEntries(metrics) };
+      /* A plain string goes out as text/plain, which needs no CORS preflight. */
+      navigator.sendBeacon(s.endpoint, JSON.stringify(body));
+    }
+  });
+})();
@@ -0,0 +1,94 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+#
+# Check the built site against the performance budget in `_data/perf_budget.yml`.
+#
+# Usage: ruby tools/perf-budget.rb [SITE_DIR] [HISTORY]
+#
+# Serves SITE_DIR locally, runs headless Lighthouse on the home page, the
+# newest post (or PERF_POST) and every `_tabs` page, appends LCP, CLS,
+# TBT, transfer size and request count to the HISTORY JSON, and exits
+# non-zero when a page goes over budget or a budgeted metric is missing
+# from the report.
+
+require 'json'
+require 'net/http'
+require 'open3'
+require 'tmpdir'
+require 'yaml'
+
+SITE_DIR = ARGV[0] || '_site'
+HISTORY = ARGV[1] || 'lighthouse-history.json'
+PORT = Integer(ENV.fetch('PERF_PORT', 4100))
+KEEP = 200
+
+METRICS = {
+  'lcp'            => ->(a) { a.dig('largest-contentful-paint', 'numericValue') },
+  'cls'            => ->(a) { a.dig('cumulative-layout-shift', 'numericValue') },
+  'tbt'            => ->(a) { a.dig('total-blocking-time', 'numericValue') },
+  'transfer_bytes' => ->(a) { a.dig('total-byte-weight', 'numericValue') },
+  'requests'       => ->(a) { a.dig('network-requests', 'details', 'items')&.size }
+}.freeze
+
+budget = YAML.safe_load(File.read('_data/perf_budget.yml')) || {}
+# Posts are served at `/posts/:title/`, the file name without the date.
+posts = Dir.glob('_posts/*.{md,markdown}').sort.reverse.map do |file|
+  "/posts/#{ File.basename(file, '.*').sub(/\A\d{4}-\d{2}-\d{2}-/, '') }/"
+end
+post = ENV['PERF_POST'] || posts.find { |url| File.file?(File.join(SITE_DIR, url, 'index.html')) }
+abort "No post found in #{ SITE_DIR }, set PERF_POST" if post.nil?
+
+tabs = Dir.glob('_tabs/*.md').sort.map { |f| "/#{ File.basename(f, '.md') }/" }
+paths = ['/', post, *tabs]
+
+server = Process.spawn('python3', '-m', 'http.server', PORT.to_s, '--bind', '127.0.0.1',
+                       chdir: SITE_DIR, out: File::NULL, err: File::NULL)
+at_exit { Process.kill('TERM', server) rescue nil }
+
+30.times do
+  break if (Net::HTTP.get_response(URI("http://127.0.0.1:#{ PORT }/")) rescue nil)
+
+  sleep 0.5
+end
+
+run = { 'sha' => ENV['GITHUB_SHA'], 'date' => Time.now.utc.strftime('%FT%TZ'), 'pages' => {} }
+failures = []
+
+Dir.mktmpdir('lighthouse') do |dir|
+  paths.each do |path|
+    report = File.join(dir, 'report.json')
+    _, err, status = Open3.capture3(
+      'npx', '--yes', 'lighthouse', "http://127.0.0.1:#{ PORT }#{ path }",
+      '--only-categories=performance', '--output=json', "--output-path=#{ report }", '--quiet',
+      '--chrome-flags=--headless=new --no-sandbox'
+    )
+    abort "Lighthouse failed on #{ path }:\n#{ err }" unless status.success?
+
+    audits = JSON.parse(File.read(report))['audits']
+    values = METRICS.transform_values { |metric| metric.call(audits) }
+    run['pages'][path] = values
+
+    limits = (budget['defaults'] || {}).merge(budget.dig('pages', path) || {})
+    limits.each do |name, limit|
+      next if limit.nil?
+
+      value = values[name]
+      if value.nil?
+        failures << "#{ path }: #{ name } missing from the Lighthouse report"
+      elsif value > limit
+        failures << "#{ path }: #{ name } #{ value.round(3) } > #{ limit }"
+      end
+    end
+
+    puts format('%-24s LCP %6.0f ms  CLS %.3f  TBT %5.0f ms  %8d B  %3d requests',
+                path, *values.values_at('lcp', 'cls', 'tbt').map(&:to_f), *values.values_at('transfer_bytes', 'requests').map(&:to_i))
+  end
+end
+
+history = File.file?(HISTORY) ? JSON.parse(File.read(HISTORY)) : []
+File.write(HISTORY, JSON.pretty_generate((history << run).last(KEEP)))
+
+unless failures.empty?
+  warn "Performance budget exceeded:\n  #{ failures.join("\n  ") }"
+  exit 1
+end
@@ -0,0 +1,56 @@
+#!/usr/bin/env node
+/*
+ * Long-lived render worker for `_plugins/prerender.rb`. Reads one JSON job
+ * per line from stdin, `{ id, kind: "tex" | "mermaid", source, display }`,
+ * and answers each with one line, `{ id, html }` or `{ id, error }`.
+ * The headless browser Mermaid needs is started on the first diagram and
+ * reused for every later one.
+ */
+'use strict';
+
+const readline = require('readline');
+
+const output = process.env.PRERENDER_MATH_OUTPUT || 'mathml';
+let katex;
+let mermaid;
+
+async function tex(job) {
+  katex = katex || require('katex');
+  return katex.renderToString(job.source, { displayMode: job.display, output, throwOnError: true });
+}
+
+async function diagram(job) {
+  if (!mermaid) {
+    mermaid = (async () => {
+      const { renderMermaid } = await import('@mermaid-js/mermaid-cli');
+      const puppeteer = (await import('puppeteer')).default;
+      const browser = await puppeteer.launch({ headless: 'new', args: ['--no-sandbox'] });
+      process.on('exit', () => browser.process() && browser.process().kill());
+      return (source) => renderMermaid(browser, source, 'svg', { backgroundColor: 'transparent' });
+    })();
+  }
+
+  const render = await mermaid;
+  const { data } = await render(job.source);
+  return Buffer.from(data).toString('utf8').replace(/^<\?xml[^>]*>\s*/, '');
+}
+
+const kinds = { tex, mermaid: diagram };
+let queue = Promise.resolve();
+
+readline.createInterface({ input: process.stdin }).on('line', (line) => {
+  const job = JSON.parse(line);
+
+  /* One job at a time, so answers come back in request order. */
+  queue = queue.then(async () => {
+    let reply;
+    try {
+      reply = { id: job.id, html: await kinds[job.kind](job) };
+    } catch (e) {
+      reply = { id: job.id, error: String((e && e.message) || e) };
+    }
+    process.stdout.write(`${JSON.stringify(reply)}\n`);
+  });
+});
+
+process.stdin.on('end', () => queue.then(() => process.exit(0)));
@@ -0,0 +1,54 @@
+/*
+ * Live patching for `tools/preview.rb`: the server pushes the new HTML of
+ * re-rendered pages, and the open page morphs its <body> into it, keeping
+ * scroll position, focus and the state of untouched elements.
+ */
+(function () {
+  'use strict';
+
+  function morph(from, to) {
+    if (from.nodeType !== to.nodeType || from.nodeName !== to.nodeName) {
+      from.replaceWith(document.importNode(to, true));
+      return;
+    }
+
+    if (from.nodeType !== Node.ELEMENT_NODE) {
+      if (from.nodeValue !== to.nodeValue) from.nodeValue = to.nodeValue;
+      return;
+    }
+
+    if (from.nodeName === 'SCRIPT') return;
+
+    Array.from(from.attributes).forEach((a) => to.hasAttribute(a.name) || from.removeAttribute(a.name));
+    Array.from(to.attributes).forEach((a) => from.getAttribute(a.name) !== a.value && from.setAttribute(a.name, a.value));
+
+    const old = Array.from(from.childNodes);
+    const next = Array.from(to.childNodes);
+    next.forEach((child, i) => (old[i] ? morph(old[i], child) : from.appendChild(document.importNode(child, true))));
+    old.slice(next.length).forEach((node) => node.remove());
+  }
+
+  function connect() {
+    const socket = new WebSocket(`${location.protocol === 'https:' ? 'wss' : 'ws'}://${location.host}/__preview`);
+
+    socket.onmessage = (event) => {
+      const message = JSON.parse(event.data);
+      if (message.type === 'reload') {
+        location.reload();
+        return;
+      }
+
+      const path = location.pathname.replace(/index\.html$/, '');
+      if (message.type === 'patch' && message.url === path) {
+        const doc = new DOMParser().parseFromString(message.html, 'text/html');
+        document.title = doc.title;
+        morph(document.body, doc.body);
+      }
+    };
+
+    /* The server restarted: reconnect and load whatever it serves now. */
+    socket.onclose = () => setTimeout(() => fetch(location.href).then(() => location.reload(), connect), 1000);
+  }
+
+  connect();
+})();
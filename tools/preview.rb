@@ -0,0 +1,315 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+#
+# Local preview server that keeps the rendered site in memory.
+#
+# Usage: bundle exec ruby tools/preview.rb [PORT]
+#
+# The site is built once into a temporary directory, so the files written
+# by post-write steps (search index, feed, service worker manifest) exist.
+# After that nothing is written: pages are served from their rendered
+# output in memory. Saving a post under `_posts` re-renders that post and
+# the listing pages showing it (home pagination, tags, categories,
+# archives), and pushes the new HTML over a WebSocket to the open tabs,
+# which patch their DOM in place. Changes to the title, date, tags or
+# categories of a post, and to any other file, re-render the whole site
+# in memory and reload the tabs.
+#
+# Static files are served from the source, so edited, added and removed
+# ones show up after the reload; the destination only supplies what the
+# post-write steps generated.
+#
+# HTML compression, image variants, font subsetting, critical CSS, asset
+# hashing and precompression are turned off.
+
+require 'base64'
+require 'digest'
+require 'json'
+require 'socket'
+require 'tmpdir'
+require 'uri'
+require 'jekyll'
+require 'listen'
+require 'webrick'
+
+PORT = (ARGV[0] || ENV['PORT'] || 4000).to_i
+ROOT = File.expand_path('..', __dir__)
+CLIENT = File.join(__dir__, 'preview-client.js')
+SOCKET_PATH = '/__preview'
+WEBSOCKET_GUID = '258EAFA5-E914-47DA-95CA-C5AB0DC85B11'
+
+OVERRIDES = {
+  'responsive_images' => { 'enabled' => false },
+  'font_subset'       => { 'enabled' => false },
+  'critical_css'      => { 'enabled' => false },
+  'precompress'       => { 'enabled' => false },
+  'asset_hash'        => { 'envs' => [] },
+  'parallel_render'   => { 'enabled' => false },
+  'build_profile'     => { 'enabled' => false }
+}.freeze
+
+# Front matter that decides which listing pages show a post.
+LISTING_KEYS = %w(title date categories tags published pin hidden).freeze
+
+# Generators that rewrite the content of posts as it was read, by name
+# since `_plugins` is only loaded with the site.
+CONTENT_GENERATORS = %w(Jekyll::Snippets::Generator Jekyll::Benchmarks::Generator).freeze
+
+class Preview
+  def initialize(dest)
+    ENV['JEKYLL_ENV'] = 'development'
+    config = Jekyll.configuration('source' => ROOT, 'destination' => dest, 'incremental' => false,
+                                  'serving' => true, 'watch' => false, 'quiet' => true)
+    OVERRIDES.each { |key, value| config[key] = (config[key] || {}).merge(value) }
+    config['compress_html'] = (config['compress_html'] || {}).merge('ignore' => { 'envs' => 'all' })
+
+    @site = Jekyll::Site.new(config)
+    @lock = Mutex.new
+    @clients = []
+    @outputs = {}
+    @statics = {}
+
+    timed('Built') { @site.process }
+    index(items)
+    @written = statics.keys
+    @lock.synchronize { @statics = statics }
+  end
+
+  attr_reader :site
+
+  def lookup(path)
+    @lock.synchronize { @outputs[path] || @outputs["#{ path }/"] || @outputs["#{ path.chomp('index.html') }"] }
+  end
+
+  # The source file of a static file, nil for anything else.
+  def static_file(path)
+    @lock.synchronize { @statics[path] || @statics["#{ path.chomp('/') }/index.html"] }
+  end
+
+  # Whether `path` was copied to the destination as a static file that no
+  # longer exists.
+  def removed?(path)
+    @lock.synchronize { @written.include?(path) && !@statics.key?(path) }
+  end
+
+  def changed(paths)
+    posts = File.join(ROOT, '_posts')
+    if paths.all? { |path| path.start_with?("#{ posts }/") && File.file?(path) }
+      paths.each { |path| refresh_post(path) }
+    else
+      rebuild
+    end
+  rescue StandardError => e
+    Jekyll.logger.error 'Preview:', "#{ e.class }: #{ e.message }"
+  end
+
+  def subscribe(socket)
+    @lock.synchronize { @clients << socket }
+  end
+
+  def unsubscribe(socket)
+    @lock.synchronize { @clients.delete(socket) }
+  end
+
+  private
+
+  def timed(label)
+    started = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+    result = yield
+    Jekyll.logger.info 'Preview:', format('%s in %.2fs', label, Process.clock_gettime(Process::CLOCK_MONOTONIC) - started)
+    result
+  end
+
+  def items
+    @site.pages + @site.collections.each_value.flat_map(&:docs).select(&:write?)
+  end
+
+  def statics
+    @site.static_files.select(&:write?).to_h { |file| [file.url, file.path] }
+  end
+
+  def index(list)
+    @lock.synchronize do
+      list.each { |item| @outputs[item.url] = item.output if item.output }
+    end
+  end
+
+  def refresh_post(path)
+    post = @site.posts.docs.find { |doc| doc.path == path }
+    return rebuild if post.nil?
+
+    # Document#read merges into the old front matter, which would keep
+    # keys that were removed from the file. The data starts over as for a
+    # new document, including what the post_init hooks add.
+    before = post.data.slice(*LISTING_KEYS)
+    post.data.clear
+    post.trigger_hooks(:post_init)
+    post.read
+    return rebuild unless post.data.slice(*LISTING_KEYS) == before
+
+    # The generators that rewrite post content, for this post only.
+    @site.generators.each do |generator|
+      generator.generate(@site, [post]) if CONTENT_GENERATORS.include?(generator.class.name)
+    end
+
+    listings = (@site.pages + Array(@site.collections['tabs']&.docs)).select do |page|
+      Array(Jekyll::ArchiveDeps.members(page)).include?(post)
+    end
+
+    timed("Rendered #{ post.relative_path } and #{ listings.size } listing page(s)") do
+      @site.liquid_renderer.reset
+      payload = @site.site_payload
+      [post, *listings].each { |item| @site.send(:render_regenerated, item, payload) }
+    end
+
+    index([post, *listings])
+    [post, *listings].each { |item| broadcast('type' => 'patch', 'url' => item.url, 'html' => item.output) }
+  end
+
+  def rebuild
+    timed('Re-rendered the site') do
+      @site.reset
+      @site.read
+      @site.generate
+      @site.render
+    end
+
+    @lock.synchronize do
+      @outputs.clear
+      @statics = statics
+    end
+    index(items)
+    broadcast('type' => 'reload')
+  end
+
+  def broadcast(message)
+    frame = websocket_frame(JSON.generate(message))
+    @lock.synchronize do
+      @clients.reject! do |socket|
+        socket.write(frame)
+        false
+      rescue IOError, SystemCallError
+        true
+      end
+    end
+  end
+
+  def websocket_frame(text)
+    bytes = text.b
+    header = if bytes.size < 126 then [0x81, bytes.size].pack('CC')
+             elsif bytes.size < 65_536 then [0x81, 126, bytes.size].pack('CCn')
+             else [0x81, 127, bytes.size].pack('CCQ>')
+             end
+    header + bytes
+  end
+end
+
+class Server
+  def initialize(preview, port)
+    @preview = preview
+    @server = TCPServer.new('127.0.0.1', port)
+    @baseurl = preview.site.baseurl.to_s
+    @client = "<script src=\"#{ SOCKET_PATH }.js\"></script>"
+  end
+
+  def run
+    loop do
+      Thread.new(@server.accept) do |socket|
+        handle(socket)
+      rescue IOError, SystemCallError
+        nil
+      ensure
+        socket.close unless socket.closed?
+      end
+    end
+  end
+
+  private
+
+  def handle(socket)
+    line = socket.gets or return
+    _, target = line.split
+    headers = {}
+    while (header = socket.gets) && header != "\r\n"
+      key, value = header.split(':', 2)
+      headers[key.strip.downcase] = value.to_s.strip
+    end
+
+    path = URI.decode_www_form_component(target.to_s.split('?').first)
+    return upgrade(socket, headers) if path == SOCKET_PATH && headers['upgrade'].to_s.casecmp?('websocket')
+    return respond(socket, 200, 'text/javascript', File.read(CLIENT)) if path == "#{ SOCKET_PATH }.js"
+
+    path = path.delete_prefix(@baseurl)
+    body = @preview.lookup(path)
+    return respond(socket, 200, 'text/html', inject(body)) if body && (path.end_with?('/', '.html') || !path.include?('.'))
+    return respond(socket, 200, mime(path), body) if body
+
+    file = static(path)
+    return respond(socket, 200, mime(file), File.binread(file)) if file
+
+    not_found = @preview.lookup('/404.html')
+    respond(socket, 404, 'text/html', inject(not_found || 'Not found'))
+  end
+
+  def inject(html)
+    html.sub('</head>') { "#{ @client }</head>" }
+  end
+
+  def static(path)
+    source = @preview.static_file(path)
+    return source if source && File.file?(source)
+    return if @preview.removed?(path)
+
+    dest = @preview.site.dest
+    file = File.expand_path(File.join(dest, path))
+    return unless file.start_with?(dest)
+
+    file = File.join(file, 'index.html') if File.directory?(file)
+    file if File.file?(file)
+  end
+
+  def mime(path)
+    WEBrick::HTTPUtils.mime_type(path, WEBrick::HTTPUtils::DefaultMimeTypes)
+  end
+
+  def respond(socket, status, type, body)
+    body = body.b
+    socket.write("HTTP/1.1 #{ status } #{ status == 200 ? 'OK' : 'Not Found' }\r\n" \
+                 "Content-Type: #{ type }\r\nContent-Length: #{ body.bytesize }\r\n" \
+                 "Cache-Control: no-store\r\nConnection: close\r\n\r\n")
+    socket.write(body)
+  end
+
+  def upgrade(socket, headers)
+    accept = Base64.strict_encode64(Digest::SHA1.digest(headers['sec-websocket-key'].to_s + WEBSOCKET_GUID))
+    socket.write("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n" \
+                 "Sec-WebSocket-Accept: #{ accept }\r\n\r\n")
+    @preview.subscribe(socket)
+
+    # Nothing is expected from the page; read until it closes.
+    loop do
+      head = socket.read(2)
+      break if head.nil? || head.bytesize < 2 || (head.getbyte(0) & 0x0f) == 0x8
+
+      length = head.getbyte(1) & 0x7f
+      length = socket.read(2).unpack1('n') if length == 126
+      length = socket.read(8).unpack1('Q>') if length == 127
+      socket.read(length + ((head.getbyte(1) & 0x80).zero? ? 0 : 4))
+    end
+  ensure
+    @preview.unsubscribe(socket)
+  end
+end
+
+Dir.mktmpdir('preview') do |dest|
+  preview = Preview.new(dest)
+
+  ignore = %r{\A(?:\.git|\.jekyll-cache|\.sass-cache|_site|node_modules|build-profile|tools)/}
+  listener = Listen.to(ROOT, ignore: ignore, latency: 0.2) do |modified, added, removed|
+    preview.changed(modified + added + removed)
+  end
+  listener.start
+
+  Jekyll.logger.info 'Preview:', "Serving on http://127.0.0.1:#{ PORT }#{ preview.site.baseurl }/"
+  Server.new(preview, PORT).run
+end
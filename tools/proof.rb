@@ -0,0 +1,72 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+#
+# Run html-proofer over the built site, in parallel and incrementally.
+#
+# Usage: bundle exec ruby tools/proof.rb [SITE_DIR] [MANIFEST]
+#
+# The manifest holds the content hash of every HTML file, and of every
+# other file an HTML file links to, from the last successful run. Only
+# HTML files whose hash changed, plus pages linking to a file that was
+# added, changed or removed, are checked again. Set
+# PROOF_ALL=1 to ignore the manifest.
+
+require 'digest'
+require 'etc'
+require 'json'
+require 'set'
+require 'html-proofer'
+
+SITE_DIR = ARGV[0] || '_site'
+MANIFEST = ARGV[1] || '.proofer-manifest.json'
+
+OPTIONS = {
+  root_dir: File.expand_path(SITE_DIR),
+  disable_external: true,
+  ignore_urls: [%r{^http://127.0.0.1}, %r{^http://0.0.0.0}, %r{^http://localhost}],
+  parallel: { in_processes: Etc.nprocessors }
+}.freeze
+
+LINK_ATTR = /\s(?:href|src)\s*=\s*["']([^"'#?]+)/i.freeze
+
+# The site-relative files a link could resolve to.
+def candidates(from, link)
+  return [] if link.match?(%r{\A(?:[a-z][a-z0-9+.-]*:|//)}i)
+
+  path = link.start_with?('/') ? link.delete_prefix('/') : File.join(File.dirname(from), link)
+  path = File.expand_path(path, '/').delete_prefix('/')
+  return ["#{ path }/index.html".delete_prefix('/')] if link.end_with?('/')
+
+  [path, "#{ path }.html", "#{ path }/index.html"]
+end
+
+files = Dir.glob('**/*.html', base: SITE_DIR).sort
+links = files.to_h do |f|
+  [f, File.read(File.join(SITE_DIR, f)).scan(LINK_ATTR).flat_map { |(link)| candidates(f, link) }.uniq]
+end
+assets = links.values.flatten.uniq.reject { |c| c.end_with?('.html') }.select { |c| File.file?(File.join(SITE_DIR, c)) }
+hashes = (files + assets.sort).to_h { |f| [f, Digest::SHA256.file(File.join(SITE_DIR, f)).hexdigest] }
+options_digest = Digest::SHA256.hexdigest(OPTIONS.inspect)
+
+previous = {}
+if ENV['PROOF_ALL'].nil? && File.file?(MANIFEST)
+  data = JSON.parse(File.read(MANIFEST)) rescue {}
+  previous = data['files'] || {} if data['options'] == options_digest
+end
+
+targets =
+  if previous.empty?
+    files
+  else
+    changed = (hashes.keys | previous.keys).reject { |f| hashes[f] == previous[f] }.to_set
+
+    files.select { |f| changed.include?(f) || links[f].any? { |c| changed.include?(c) } }
+  end
+
+puts "Proofing #{ targets.size } of #{ files.size } HTML files"
+
+unless targets.empty?
+  HTMLProofer.check_files(targets.map { |f| File.join(SITE_DIR, f) }, OPTIONS).run
+end
+
+File.write(MANIFEST, JSON.generate('options' => options_digest, 'files' => hashes))